@@ -229,6 +229,37 @@ static int config_setting_lookup_orientation(const config_setting_t *setting,
     return success_status;
 }
 
+static int config_setting_lookup_text_renderer(
+    const config_setting_t *setting, const char *name, Text_renderer *value)
+{
+    const char *stringvalue;
+    int success_status = CONFIG_FALSE;
+
+    if (config_setting_lookup_string(setting, name, &stringvalue))
+    {
+        if (strcmp(stringvalue, "font") == 0)
+        {
+            *value = TEXT_FONT;
+            success_status = CONFIG_TRUE;
+        }
+        else if (strcmp(stringvalue, "pixel") == 0)
+        {
+            *value = TEXT_PIXEL;
+            success_status = CONFIG_TRUE;
+        }
+        else
+        {
+            fprintf(stderr,
+                    "Error: in configuration, line %d - "
+                    "Invalid text renderer. Expected \"font\" or "
+                    "\"pixel\".\n",
+                    config_setting_source_line(setting));
+        }
+    }
+
+    return success_status;
+}
+
 static int config_setting_lookup_monitor(const config_setting_t *setting,
                                          const char *name, char *monitorvalue)
 {
@@ -254,6 +285,10 @@ static int config_setting_lookup_text_elem(const config_setting_t *text_setting,
     if (text_setting != NULL)
     {
         const char *stringvalue;
+        text->renderer = TEXT_FONT;
+        config_setting_lookup_text_renderer(text_setting, "renderer",
+                                            &text->renderer);
+
         if (config_setting_lookup_string(text_setting, "font_name",
                                          &stringvalue))
         {
@@ -279,6 +314,7 @@ static int config_setting_lookup_text_elem(const config_setting_t *text_setting,
             {
                 strncpy(text->color, stringvalue, 10);
                 text->color[strlen(stringvalue)] = '\0';
+                text->rgba = parse_color(stringvalue);
             }
             else
             {
@@ -290,7 +326,10 @@ static int config_setting_lookup_text_elem(const config_setting_t *text_setting,
             }
         }
         else
+        {
             text->color[0] = '\0';
+            text->rgba = (Color){0xff, 0xff, 0xff, 0xff};
+        }
 
         config_setting_lookup_dim(text_setting, "x", &text->x);
         config_setting_lookup_dim(text_setting, "y", &text->y);
@@ -432,3 +471,44 @@ void style_free(const Style *style)
     }
     free(style->text_list.ptext);
 }
+
+char **parse_style_names(FILE *file, int *pcount)
+{
+    config_t config;
+    config_setting_t *root;
+    config_setting_t *setting;
+    char **names = NULL;
+    const char *name;
+    int length;
+    int i;
+
+    *pcount = 0;
+    config_init(&config);
+    if (config_read(&config, file))
+    {
+        /* Every group at the root level is a style */
+        root = config_root_setting(&config);
+        length = config_setting_length(root);
+        names = (char **)malloc(sizeof(char *) * (length > 0 ? length : 1));
+        for (i = 0; names != NULL && i < length; i++)
+        {
+            setting = config_setting_get_elem(root, i);
+            if (!config_setting_is_group(setting))
+                continue;
+            name = config_setting_name(setting);
+            names[*pcount] = (char *)malloc(strlen(name) + 1);
+            strcpy(names[*pcount], name);
+            (*pcount)++;
+        }
+    }
+    config_destroy(&config);
+    return names;
+}
+
+void style_names_free(char **names, int count)
+{
+    int i;
+    for (i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+}
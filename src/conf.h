@@ -73,11 +73,21 @@ typedef struct
     double y;
 } Align_pos;
 
+/* How a text is drawn: with its font, or with the built-in pixel font of
+ * digits, which loads no font and draws rectangles like the bar */
+typedef enum
+{
+    TEXT_FONT,
+    TEXT_PIXEL
+} Text_renderer;
+
 typedef struct
 {
+    Text_renderer renderer;
     char *font_name;
     char *string;
     char color[11];
+    Color rgba; /* Of the color, for the pixel font */
     Dim x;
     Dim y;
     Align_pos align;
@@ -239,4 +249,9 @@ Style parse_style_config(FILE *filename, const char *stylename,
                          Style default_style);
 void style_free(const Style *style);
 
+/* Names of the styles defined in a configuration file, to be freed with
+ * style_names_free. Returns NULL with a count of 0 if the file is invalid. */
+char **parse_style_names(FILE *file, int *pcount);
+void style_names_free(char **names, int count);
+
 #endif /* __CONF_H__ */
@@ -15,9 +15,11 @@
  * along with xob.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define _XOPEN_SOURCE 500
 #include "display.h"
 #include "log.h"
 #include "parser.h"
+#include "pixelfont.h"
 
 #include <X11/Xatom.h>
 #include <X11/Xft/Xft.h>
@@ -25,10 +27,59 @@
 #include <X11/Xutil.h>
 #include <X11/extensions/Xdbe.h>
 #include <X11/extensions/Xrandr.h>
+#ifdef WITH_XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif
 #include <stdbool.h>
-#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+/* Requests sent to the active or focused windows, which may be destroyed at
+ * any time: BadWindow is expected from them. The last few ranges are kept
+ * since errors arrive after the requests. */
+#define EXPECTED_RANGES 4
+
+static struct
+{
+    unsigned long first;
+    unsigned long last;
+} expected_ranges[EXPECTED_RANGES];
+static int expected_next;
+
+/* Expect BadWindow from the next requests until expect_end, including the
+ * synchronous ones reported in between */
+static void expect_begin(Display *display)
+{
+    expected_ranges[expected_next].first = NextRequest(display);
+    expected_ranges[expected_next].last = (unsigned long)-1;
+}
+
+static void expect_end(Display *display)
+{
+    expected_ranges[expected_next].last = NextRequest(display) - 1;
+    expected_next = (expected_next + 1) % EXPECTED_RANGES;
+}
+
+/* Report X errors instead of exiting (e.g. a focused window that has just
+ * been destroyed) */
+static int handle_x_error(Display *display, XErrorEvent *error)
+{
+    char text[128];
+    int i;
+
+    for (i = 0; error->error_code == BadWindow && i < EXPECTED_RANGES; i++)
+    {
+        if (error->serial >= expected_ranges[i].first &&
+            error->serial <= expected_ranges[i].last)
+            return 0;
+    }
+    XGetErrorText(display, error->error_code, text, sizeof(text));
+    fprintf(stderr, "Error: X request %d failed: %s\n", error->request_code,
+            text);
+    return 0;
+}
 
 /* Keep value in range */
 static int fit_in(int value, int min, int max)
@@ -38,6 +89,87 @@ static int fit_in(int value, int min, int max)
     return value;
 }
 
+/* Consecutive rectangles of the same color, drawn with a single request */
+#define BATCH_SIZE 16
+
+typedef struct
+{
+    X_context x;
+    Drawable drawable;
+    const Color *palette;
+    int palette_size;
+    int color; /* Index in the palette */
+    XRectangle rectangles[BATCH_SIZE];
+    int count;
+    const XRectangle *clip; /* Damaged area, the whole window if NULL */
+    int clip_count;
+} Rectangle_batch;
+
+static bool same_color(Color a, Color b)
+{
+    return a.red == b.red && a.green == b.green && a.blue == b.blue &&
+           a.alpha == b.alpha;
+}
+
+static void batch_flush(Rectangle_batch *pbatch)
+{
+    if (pbatch->count > 0)
+        pbatch->x.renderer->fill_rectangles(pbatch->x, pbatch->drawable,
+                                            pbatch->color, pbatch->rectangles,
+                                            pbatch->count);
+    pbatch->count = 0;
+}
+
+static void batch_add(Rectangle_batch *pbatch, int color, int x, int y, int w,
+                      int h)
+{
+    if (w <= 0 || h <= 0)
+        return;
+
+    if (color != pbatch->color || pbatch->count == BATCH_SIZE)
+    {
+        batch_flush(pbatch);
+        pbatch->color = color;
+    }
+    pbatch->rectangles[pbatch->count++] =
+        (XRectangle){.x = x, .y = y, .width = w, .height = h};
+}
+
+/* Queue a rectangle, drawing the previous ones first if their color differs.
+ * Overlapping rectangles are thus drawn in order. Only the colors of the
+ * palette can be drawn, and only within the damaged area. */
+static void fill_rectangle(Rectangle_batch *pbatch, Color color, int x, int y,
+                           unsigned int w, unsigned int h)
+{
+    int i, c;
+    int x1, y1, x2, y2;
+
+    for (i = 0; i < pbatch->palette_size &&
+                !same_color(pbatch->palette[i], color);
+         i++)
+        ;
+    if (i == pbatch->palette_size)
+        return;
+
+    if (pbatch->clip == NULL)
+    {
+        batch_add(pbatch, i, x, y, w, h);
+        return;
+    }
+
+    /* Intersections with the damaged rectangles */
+    for (c = 0; c < pbatch->clip_count; c++)
+    {
+        x1 = x > pbatch->clip[c].x ? x : pbatch->clip[c].x;
+        y1 = y > pbatch->clip[c].y ? y : pbatch->clip[c].y;
+        x2 = fit_in(x + (int)w, x1,
+                    pbatch->clip[c].x + pbatch->clip[c].width);
+        y2 = fit_in(y + (int)h, y1,
+                    pbatch->clip[c].y + pbatch->clip[c].height);
+        batch_add(pbatch, i, x1, y1, x2 - x1, y2 - y1);
+    }
+}
+
 /* Horizontal and vertical size depending on orientation */
 static int size_x(Geometry_context g)
 {
@@ -49,128 +181,138 @@ static int size_y(Geometry_context g)
     return g.orientation == HORIZONTAL ? g.thickness : g.length;
 }
 
-/* Draw an empty bar with the given colors */
-static void draw_empty(X_context x, Geometry_context g, Colors colors)
+/* Size of the pixels of the pixel font, from the thickness of the bar */
+static int pixel_scale(Geometry_context g)
+{
+    return g.thickness / 8 > 1 ? g.thickness / 8 : 1;
+}
+
+/* Draw an empty bar with the given colors. The rectangles of the same color
+ * are adjacent so that they are drawn together. */
+static void draw_empty(Rectangle_batch *pbatch, Geometry_context g,
+                       Colors colors)
 {
     /* Fill with transparent layer so other windows can update
      * content behind the bar (works only with compositors) */
     Color transparent = {.red = 0x0, .green = 0x0, .blue = 0x0, .alpha = 0x0};
-    fill_rectangle(x, transparent, 0, 0, g.x.offset + g.x.max,
+    fill_rectangle(pbatch, transparent, 0, 0, g.x.offset + g.x.max,
                    g.y.offset + g.y.max);
 
-    /* Outline */
-    /* Left */
-    fill_rectangle(x, colors.bg, 0 + g.x.offset, 0 + g.y.offset, g.outline,
-                   2 * (g.outline + g.border + g.padding) + size_y(g));
-
-    /* Right */
-    fill_rectangle(x, colors.bg,
-                   2 * (g.border + g.padding) + g.outline + size_x(g) +
-                       g.x.offset,
-                   0 + g.y.offset, g.outline,
-                   2 * (g.outline + g.border + g.padding) + size_y(g));
-
-    /* Top */
-    fill_rectangle(x, colors.bg, 0 + g.x.offset, 0 + g.y.offset,
-                   2 * (g.outline + g.border + g.padding) + size_x(g),
-                   g.outline);
-
-    /* Bottom */
-    fill_rectangle(
-        x, colors.bg, 0 + g.x.offset,
-        2 * (g.border + g.padding) + g.outline + size_y(g) + g.y.offset,
-        2 * (g.outline + g.border + g.padding) + size_x(g), g.outline);
-
     /* Border */
     /* Left */
-    fill_rectangle(x, colors.border, g.outline + g.x.offset,
+    fill_rectangle(pbatch, colors.border, g.outline + g.x.offset,
                    g.outline + g.y.offset, g.border,
                    2 * (g.border + g.padding) + size_y(g));
 
     /* Right */
-    fill_rectangle(x, colors.border,
+    fill_rectangle(pbatch, colors.border,
                    g.outline + g.border + 2 * g.padding + size_x(g) +
                        g.x.offset,
                    g.outline + g.y.offset, g.border,
                    2 * (g.border + g.padding) + size_y(g));
 
     /* Top */
-    fill_rectangle(x, colors.border, g.outline + g.x.offset,
+    fill_rectangle(pbatch, colors.border, g.outline + g.x.offset,
                    g.outline + g.y.offset,
                    2 * (g.border + g.padding) + size_x(g), g.border);
 
     /* Bottom */
-    fill_rectangle(x, colors.border, g.outline + g.x.offset,
+    fill_rectangle(pbatch, colors.border, g.outline + g.x.offset,
                    g.outline + g.border + 2 * g.padding + size_y(g) +
                        g.y.offset,
                    2 * (g.border + g.padding) + size_x(g), g.border);
 
+    /* Outline */
+    /* Left */
+    fill_rectangle(pbatch, colors.bg, 0 + g.x.offset, 0 + g.y.offset,
+                   g.outline,
+                   2 * (g.outline + g.border + g.padding) + size_y(g));
+
+    /* Right */
+    fill_rectangle(pbatch, colors.bg,
+                   2 * (g.border + g.padding) + g.outline + size_x(g) +
+                       g.x.offset,
+                   0 + g.y.offset, g.outline,
+                   2 * (g.outline + g.border + g.padding) + size_y(g));
+
+    /* Top */
+    fill_rectangle(pbatch, colors.bg, 0 + g.x.offset, 0 + g.y.offset,
+                   2 * (g.outline + g.border + g.padding) + size_x(g),
+                   g.outline);
+
+    /* Bottom */
+    fill_rectangle(
+        pbatch, colors.bg, 0 + g.x.offset,
+        2 * (g.border + g.padding) + g.outline + size_y(g) + g.y.offset,
+        2 * (g.outline + g.border + g.padding) + size_x(g), g.outline);
+
     /* Padding */
     /* Left */
-    fill_rectangle(x, colors.bg, g.outline + g.border + g.x.offset,
+    fill_rectangle(pbatch, colors.bg, g.outline + g.border + g.x.offset,
                    g.outline + g.border + g.y.offset, g.padding,
                    2 * g.padding + size_y(g));
 
     /* Right */
-    fill_rectangle(x, colors.bg,
+    fill_rectangle(pbatch, colors.bg,
                    g.outline + g.border + g.padding + size_x(g) + g.x.offset,
                    g.outline + g.border + g.y.offset, g.padding,
                    2 * g.padding + size_y(g));
 
     /* Top */
-    fill_rectangle(x, colors.bg, g.outline + g.border + g.x.offset,
+    fill_rectangle(pbatch, colors.bg, g.outline + g.border + g.x.offset,
                    g.outline + g.border + g.y.offset, 2 * g.padding + size_x(g),
                    g.padding);
 
     /* Bottom */
-    fill_rectangle(x, colors.bg, g.outline + g.border + g.x.offset,
+    fill_rectangle(pbatch, colors.bg, g.outline + g.border + g.x.offset,
                    g.outline + g.border + g.padding + size_y(g) + g.y.offset,
                    2 * g.padding + size_x(g), g.padding);
 }
 
-/* Draw a given length of filled bar with the given color */
-static void draw_content(X_context x, Geometry_context g, int filled_length,
-                         Colors colors)
+/* Draw a given length of filled bar with the given color. The background
+ * comes first to follow the padding of the same color. */
+static void draw_content(Rectangle_batch *pbatch, Geometry_context g,
+                         int filled_length, Colors colors)
 {
     if (g.orientation == HORIZONTAL)
     {
-        /* Fill foreground color */
-        fill_rectangle(x, colors.fg,
-                       g.outline + g.border + g.padding + g.x.offset,
-                       g.outline + g.border + g.padding + g.y.offset,
-                       filled_length, g.thickness);
-
         /* Fill background color */
-        fill_rectangle(x, colors.bg,
+        fill_rectangle(pbatch, colors.bg,
                        g.outline + g.border + g.padding + filled_length +
                            g.x.offset,
                        g.outline + g.border + g.padding + g.y.offset,
                        g.length - filled_length, g.thickness);
+
+        /* Fill foreground color */
+        fill_rectangle(pbatch, colors.fg,
+                       g.outline + g.border + g.padding + g.x.offset,
+                       g.outline + g.border + g.padding + g.y.offset,
+                       filled_length, g.thickness);
     }
     else
     {
+        /* Fill background color */
+        fill_rectangle(pbatch, colors.bg,
+                       g.outline + g.border + g.padding + g.x.offset,
+                       g.outline + g.border + g.padding + g.y.offset,
+                       g.thickness, g.length - filled_length);
+
         /* fill foreground color */
-        fill_rectangle(x, colors.fg,
+        fill_rectangle(pbatch, colors.fg,
                        g.outline + g.border + g.padding + g.x.offset,
                        g.outline + g.border + g.padding + g.length -
                            filled_length + g.y.offset,
                        g.thickness, filled_length);
-
-        /* Fill background color */
-        fill_rectangle(x, colors.bg,
-                       g.outline + g.border + g.padding + g.x.offset,
-                       g.outline + g.border + g.padding + g.y.offset,
-                       g.thickness, g.length - filled_length);
     }
 }
 
 /* Draw a separator (padding-sized gap) at the given position */
-static void draw_separator(X_context x, Geometry_context g, int position,
-                           Color color)
+static void draw_separator(Rectangle_batch *pbatch, Geometry_context g,
+                           int position, Color color)
 {
     if (g.orientation == HORIZONTAL)
     {
-        fill_rectangle(x, color,
+        fill_rectangle(pbatch, color,
                        g.outline + g.border + (g.padding / 2) + position +
                            g.x.offset,
                        g.outline + g.border + g.padding + g.y.offset, g.padding,
@@ -178,13 +320,29 @@ static void draw_separator(X_context x, Geometry_context g, int position,
     }
     else
     {
-        fill_rectangle(x, color, g.outline + g.border + g.padding + g.x.offset,
+        fill_rectangle(pbatch, color,
+                       g.outline + g.border + g.padding + g.x.offset,
                        g.outline + g.border + (g.padding / 2) + g.length -
                            position + g.y.offset,
                        g.thickness, g.padding);
     }
 }
 
+/* Forget the empty bars rendered for another geometry */
+static void invalidate_frame_cache(Display_context *pdc)
+{
+    int state;
+
+    for (state = 0; state < STATE_COUNT; state++)
+    {
+        if (pdc->frame_cache.pixmaps[state] != None)
+        {
+            XFreePixmap(pdc->x.display, pdc->frame_cache.pixmaps[state]);
+            pdc->frame_cache.pixmaps[state] = None;
+        }
+    }
+}
+
 void compute_geometry(Display_context *pdc, int *topleft_x, int *topleft_y)
 {
     /* Orientation-related dimensions */
@@ -212,15 +370,56 @@ void compute_geometry(Display_context *pdc, int *topleft_x, int *topleft_y)
                  pdc->geometry.y.abs + pdc->x.monitor_info.y;
 }
 
+/* Extents of a text, measured once per string and font */
+static void measure_text(Display_context *pdc, Text_context *ptext)
+{
+    const Text_layout *playout;
+    int scale = pixel_scale(pdc->geometry);
+
+    if (ptext->renderer == TEXT_PIXEL)
+    {
+        /* The origin is at the bottom left like a baseline */
+        ptext->extents.width = pixel_font_width(ptext->string, scale);
+        ptext->extents.height = PIXEL_FONT_HEIGHT * scale;
+        ptext->extents.x = 0;
+        ptext->extents.y = ptext->extents.height;
+        ptext->extents.xOff = ptext->extents.width;
+        ptext->extents.yOff = 0;
+        ptext->width = ptext->extents.width;
+        ptext->height = ptext->extents.y;
+        return;
+    }
+
+    if (ptext->font == NULL)
+    {
+        /* Takes no room until the font is loaded */
+        memset(&ptext->extents, 0, sizeof(XGlyphInfo));
+        ptext->width = 0;
+        ptext->height = 0;
+        return;
+    }
+
+    playout = layout_lookup(pdc->x.layouts, pdc->x.display, ptext->font,
+                            ptext->string);
+    if (playout != NULL)
+        ptext->extents = playout->extents;
+    else
+        XftTextExtentsUtf8(pdc->x.display, ptext->font,
+                           (const FcChar8 *)ptext->string,
+                           strlen(ptext->string), &ptext->extents);
+    ptext->width = ptext->extents.width;
+    // dc.text_rendering.ptext->height = text_info.height;
+    ptext->height = ptext->extents.y;
+}
+
 static void compute_text_position(Display_context *pdc)
 {
     // print_loge("DEBUG: compute_text_position()\n");
+    pdc->text_rendering.specs_valid = false;
     pdc->geometry.x.max = pdc->geometry.size_x;
     pdc->geometry.y.max = pdc->geometry.size_y;
     pdc->geometry.x.offset = 0;
     pdc->geometry.y.offset = 0;
-    XGlyphInfo text_info;
-    int str_len;
 
     int i;
     for (i = 0; i < pdc->text_rendering.text_count; i++)
@@ -228,16 +427,7 @@ static void compute_text_position(Display_context *pdc)
         if (pdc->text_rendering.ptext[i].string == NULL)
             continue;
         if (pdc->text_rendering.ptext[i].is_dynamic)
-        {
-            str_len = strlen(pdc->text_rendering.ptext[i].string);
-            XftTextExtentsUtf8(
-                pdc->x.display, pdc->text_rendering.ptext[i].font,
-                (const FcChar8 *)pdc->text_rendering.ptext[i].string, str_len,
-                &text_info);
-            pdc->text_rendering.ptext[i].width = text_info.width;
-            // dc.text_rendering.ptext->height = text_info.height;
-            pdc->text_rendering.ptext[i].height = text_info.y;
-        }
+            measure_text(pdc, &pdc->text_rendering.ptext[i]);
 
         /* Calculate coordinate x */
         pdc->text_rendering.ptext[i].pos.x =
@@ -282,43 +472,73 @@ static void compute_text_position(Display_context *pdc)
     pdc->geometry.y.offset = -pdc->geometry.y.offset;
 }
 
-/* Fill dynamic strings in pdc.text_rendering.ptext with words_list */
-static void compute_dynamic_strings(Display_context *pdc, char **words_list)
+/* Fill dynamic strings in pdc.text_rendering.ptext with words_list. The
+ * strings on display are kept when they do not change. Returns false, with
+ * every string left as it is, if words_list is too short for a text. */
+static bool compute_dynamic_strings(Display_context *pdc, char **words_list,
+                                    int cap)
 {
     int i;
     int words_list_len = 0;
-    int words_len = 0;
     int word_max_len;
+    char *string;
+    bool differs;
+    Text_context *ptext;
 
     /* Count length of words_list */
     while (words_list[words_list_len] != NULL)
-    {
-        words_len += strlen(words_list[words_list_len]);
         words_list_len++;
-    }
     print_loge("DEBUG: words_list_len is %d\n", words_list_len);
-    print_loge("DEBUG: words_len is %d\n", words_len);
 
     for (i = 0; i < pdc->text_rendering.text_count; i++)
     {
-        if (pdc->text_rendering.ptext[i].is_dynamic)
+        ptext = &pdc->text_rendering.ptext[i];
+        if (ptext->is_dynamic && ptext->pdyn_str->words > words_list_len)
+        {
+            fprintf(stderr, "Error: %d words needed by the texts, line "
+                            "ignored.\n",
+                    ptext->pdyn_str->words);
+            return false;
+        }
+    }
+
+    for (i = 0; i < pdc->text_rendering.text_count; i++)
+    {
+        ptext = &pdc->text_rendering.ptext[i];
+        if (ptext->is_dynamic)
         {
+            /* The buffer is swapped with the string on display, so that
+             * strings are only allocated when they grow */
             word_max_len =
-                words_len +
-                strlen_dyn_str(pdc->text_rendering.ptext[i].pdyn_str) + 1;
-            pdc->text_rendering.ptext[i].string =
-                (char *)malloc(sizeof(char) * word_max_len);
-            if (!fill_dyn_str(pdc->text_rendering.ptext[i].string,
-                              pdc->text_rendering.ptext[i].pdyn_str, words_list,
-                              words_list_len))
+                size_dyn_str(ptext->pdyn_str, words_list, words_list_len);
+            if (ptext->next_size < word_max_len)
+            {
+                free(ptext->next_string);
+                ptext->next_string = (char *)malloc(word_max_len);
+                ptext->next_size = word_max_len;
+            }
+            string = ptext->next_string;
+            fill_dyn_str(string, ptext->pdyn_str, words_list, words_list_len,
+                         cap);
+            print_loge("DEBUG: dyn_str is [%s]\n", string);
+
+            /* Still set if the font of the text has been loaded since it
+             * was last placed */
+            differs =
+                ptext->string == NULL || strcmp(ptext->string, string) != 0;
+            ptext->changed = ptext->changed || differs;
+            if (differs)
             {
-                fprintf(stderr, "ERROR: not enough strings provided\n");
-                exit(1);
+                pdc->text_rendering.specs_valid = false;
+                word_max_len = ptext->next_size;
+                ptext->next_string = ptext->string;
+                ptext->next_size = ptext->string_size;
+                ptext->string = string;
+                ptext->string_size = word_max_len;
             }
-            print_loge("DEBUG: dyn_str is [%s]\n",
-                       pdc->text_rendering.ptext[i].string);
         }
     }
+    return true;
 }
 
 /* Set combined positon */
@@ -332,31 +552,28 @@ static void set_combined_position(Display_context *pdc)
 }
 
 /* Set specified monitor */
-static void set_specified_position(Display_context *pdc, const Style *pconf)
+static const MonitorInfo *find_monitor_by_name(const Monitor_list *plist,
+                                               const char *name)
 {
-    Window root = RootWindow(pdc->x.display, pdc->x.screen_number);
-
-    /* Get monitors info */
-    int num_monitors;
-    char *monitor_name;
-    XRRMonitorInfo *monitor_sizes =
-        XRRGetMonitors(pdc->x.display, root, 0, &num_monitors);
-
-    /* Compare monitors output names */
     int i;
-    for (i = 0; i < num_monitors; i++)
+
+    for (i = 0; i < plist->count; i++)
     {
-        monitor_name = XGetAtomName(pdc->x.display, monitor_sizes[i].name);
-        if (strcmp(pconf->monitor, monitor_name) == 0)
-            break;
+        if (strcmp(plist->monitors[i].name, name) == 0)
+            return &plist->monitors[i];
     }
-    if (i != num_monitors)
+    return NULL;
+}
+
+static void set_specified_position(Display_context *pdc, const Style *pconf)
+{
+    /* Compare monitors output names */
+    const MonitorInfo *pmonitor =
+        find_monitor_by_name(pdc->x.monitors, pconf->monitor);
+
+    if (pmonitor != NULL)
     {
-        pdc->x.monitor_info.x = monitor_sizes[i].x;
-        pdc->x.monitor_info.y = monitor_sizes[i].y;
-        pdc->x.monitor_info.width = monitor_sizes[i].width;
-        pdc->x.monitor_info.height = monitor_sizes[i].height;
-        strcpy(pdc->x.monitor_info.name, monitor_name);
+        pdc->x.monitor_info = *pmonitor;
     }
     else // Monitor name is not found
     {
@@ -365,128 +582,409 @@ static void set_specified_position(Display_context *pdc, const Style *pconf)
         fprintf(stderr, "Error: monitor %s is not found.\n", pconf->monitor);
         fprintf(stderr, "Info: falling back to combined mode.\n");
         set_combined_position(pdc);
-        // strcpy(pdc.x.monitor_info.name, MONITOR_COMBINED);
+        /* Moved to the monitor if it is plugged in later */
+        strcpy(pdc->x.monitor_info.name, pconf->monitor);
     }
-    XRRFreeMonitors(monitor_sizes);
 }
 
-/* Move and resize the bar relative to a monitor with provided coords */
-static void move_resize_to_coords_monitor(Display_context *pdc, int x, int y)
+/* Whether a dynamic text of the last update differs from the one before, in
+ * which case its extents may have changed */
+static bool texts_changed(const Display_context *pdc)
 {
     int i;
+
+    for (i = 0; i < pdc->text_rendering.text_count; i++)
+    {
+        if (pdc->text_rendering.ptext[i].changed)
+            return true;
+    }
+    return false;
+}
+
+/* Move and resize the window with as few requests as possible: a resize
+ * makes the server reallocate the back buffer */
+static void configure_window(X_context *px, XRectangle area)
+{
+    bool same_position = area.x == px->area.x && area.y == px->area.y;
+    bool same_size =
+        area.width == px->area.width && area.height == px->area.height;
+
+    if (same_position && same_size)
+        return;
+    if (same_size)
+        XMoveWindow(px->display, px->window, area.x, area.y);
+    else if (same_position)
+        XResizeWindow(px->display, px->window, area.width, area.height);
+    else
+        XMoveResizeWindow(px->display, px->window, area.x, area.y, area.width,
+                          area.height);
+    print_loge("DEBUG: window configured to %dx%d+%d+%d\n", area.width,
+               area.height, area.x, area.y);
+    px->area = area;
+}
+
+/* Move and resize the bar after a change of its monitor or of the extents of
+ * its dynamic texts */
+static void move_resize_to_monitor(Display_context *pdc,
+                                   const MonitorInfo *pmonitor)
+{
     int topleft_x, topleft_y;
-    int num_monitors;
-    XRRMonitorInfo *monitor_sizes;
+    XRectangle area;
 
-    monitor_sizes = XRRGetMonitors(
-        pdc->x.display, RootWindow(pdc->x.display, pdc->x.screen_number), 0,
-        &num_monitors);
-    for (i = 0; i < num_monitors; i++)
+    /* Nothing to compute nor configure on the same monitor */
+    if (pdc->x.monitor_info.width == pmonitor->width &&
+        pdc->x.monitor_info.height == pmonitor->height &&
+        pdc->x.monitor_info.x == pmonitor->x &&
+        pdc->x.monitor_info.y == pmonitor->y && !texts_changed(pdc))
+        return;
+
+    pdc->x.monitor_info.width = pmonitor->width;
+    pdc->x.monitor_info.height = pmonitor->height;
+    pdc->x.monitor_info.x = pmonitor->x;
+    pdc->x.monitor_info.y = pmonitor->y;
+
+    compute_geometry(pdc, &topleft_x, &topleft_y);
+
+    if (pdc->text_rendering.text_count != 0)
+        compute_text_position(pdc);
+
+    area.x = topleft_x - pdc->geometry.x.offset;
+    area.y = topleft_y - pdc->geometry.y.offset;
+    area.width = pdc->geometry.x.offset + pdc->geometry.x.max;
+    area.height = pdc->geometry.y.offset + pdc->geometry.y.max;
+    configure_window(&pdc->x, area);
+}
+
+/* Keep a bar at a fixed position on its monitor after the monitors change,
+ * and repaint it if it is on screen. Bars relative to the focus or the
+ * pointer are placed when shown. */
+static void follow_monitor(Display_context *pdc)
+{
+    const MonitorInfo *pmonitor;
+    MonitorInfo screen = {.x = 0,
+                          .y = 0,
+                          .width = WidthOfScreen(pdc->x.screen),
+                          .height = HeightOfScreen(pdc->x.screen)};
+
+    switch (pdc->geometry.bar_position)
+    {
+    case POSITION_SPECIFIED:
+        /* On the combined surface while the monitor is unplugged */
+        pmonitor =
+            find_monitor_by_name(pdc->x.monitors, pdc->x.monitor_info.name);
+        move_resize_to_monitor(pdc, pmonitor != NULL ? pmonitor : &screen);
+        break;
+    case POSITION_COMBINED:
+        move_resize_to_monitor(pdc, &screen);
+        break;
+    default:
+        return;
+    }
+
+    /* The frame no longer matches the resized window */
+    if (pdc->x.mapped)
+    {
+        pdc->frame.valid = false;
+        show(pdc, pdc->last.value, pdc->last.cap, pdc->last.overflow_mode,
+             pdc->last.show_mode, NULL);
+    }
+}
+
+/* Move and resize the bar relative to the monitor containing a point */
+static void move_resize_to_coords_monitor(Display_context *pdc, int x, int y)
+{
+    const MonitorInfo *monitors = pdc->x.monitors->monitors;
+    int i;
+
+    for (i = 0; i < pdc->x.monitors->count; i++)
     {
         /* Find monitor by coords */
-        if (x >= monitor_sizes[i].x &&
-            x < monitor_sizes[i].x + monitor_sizes[i].width &&
-            y >= monitor_sizes[i].y &&
-            y < monitor_sizes[i].y + monitor_sizes[i].height)
+        if (x >= monitors[i].x && x < monitors[i].x + monitors[i].width &&
+            y >= monitors[i].y && y < monitors[i].y + monitors[i].height)
         {
-            break;
+            move_resize_to_monitor(pdc, &monitors[i]);
+            return;
         }
     }
-    pdc->x.monitor_info.width = monitor_sizes[i].width;
-    pdc->x.monitor_info.height = monitor_sizes[i].height;
-    pdc->x.monitor_info.x = monitor_sizes[i].x;
-    pdc->x.monitor_info.y = monitor_sizes[i].y;
-    XRRFreeMonitors(monitor_sizes);
+}
 
-    compute_geometry(pdc, &topleft_x, &topleft_y);
+/* The locate_ functions return the point around which to show the bar, or
+ * false if there is none. The XCB versions send all the independent requests
+ * before waiting for the replies. */
+#ifdef WITH_XCB
 
-    if (pdc->text_rendering.text_count != 0)
-        compute_text_position(pdc);
+/* Center of a window in a single round trip for its position and its size */
+static bool locate_window(Display *display, int screen_number, Window window,
+                          int *px, int *py)
+{
+    xcb_connection_t *connection = XGetXCBConnection(display);
+    xcb_translate_coordinates_cookie_t coordinates_cookie;
+    xcb_get_geometry_cookie_t geometry_cookie;
+    xcb_translate_coordinates_reply_t *coordinates;
+    xcb_get_geometry_reply_t *geometry;
+    bool located = false;
+
+    coordinates_cookie = xcb_translate_coordinates(
+        connection, window, RootWindow(display, screen_number), 0, 0);
+    geometry_cookie = xcb_get_geometry(connection, window);
+    coordinates =
+        xcb_translate_coordinates_reply(connection, coordinates_cookie, NULL);
+    geometry = xcb_get_geometry_reply(connection, geometry_cookie, NULL);
+    if (coordinates != NULL && geometry != NULL)
+    {
+        print_loge("DEBUG: focused_x [%d] focused_y [%d]\n",
+                   coordinates->dst_x, coordinates->dst_y);
+        *px = coordinates->dst_x + geometry->width / 2;
+        *py = coordinates->dst_y + geometry->height / 2;
+        located = coordinates->dst_x >= 0 || coordinates->dst_y >= 0;
+    }
+    free(coordinates);
+    free(geometry);
+    return located;
+}
+
+/* Two round trips: the focused window, then its position and its size */
+static bool locate_focus(Display_context *pdc, int *px, int *py)
+{
+    xcb_connection_t *connection = XGetXCBConnection(pdc->x.display);
+    xcb_get_input_focus_reply_t *focus;
+    bool located = false;
+
+    focus = xcb_get_input_focus_reply(
+        connection, xcb_get_input_focus(connection), NULL);
+    if (focus != NULL && focus->focus != XCB_NONE &&
+        focus->focus != XCB_INPUT_FOCUS_POINTER_ROOT)
+    {
+        located = locate_window(pdc->x.display, pdc->x.screen_number,
+                                focus->focus, px, py);
+    }
+    free(focus);
+    return located;
+}
 
-    XMoveResizeWindow(pdc->x.display, pdc->x.window,
-                      topleft_x - pdc->geometry.x.offset,
-                      topleft_y - pdc->geometry.y.offset,
-                      pdc->geometry.x.offset + pdc->geometry.x.max,
-                      pdc->geometry.y.offset + pdc->geometry.y.max);
+static bool locate_pointer(Display_context *pdc, int *px, int *py)
+{
+    xcb_connection_t *connection = XGetXCBConnection(pdc->x.display);
+    xcb_query_pointer_reply_t *pointer = xcb_query_pointer_reply(
+        connection,
+        xcb_query_pointer(connection,
+                          RootWindow(pdc->x.display, pdc->x.screen_number)),
+        NULL);
+
+    if (pointer == NULL)
+        return false;
+    *px = pointer->root_x;
+    *py = pointer->root_y;
+    free(pointer);
+    return true;
 }
 
-/* Move the bar to monitor with focused window */
-static void move_resize_to_focused_monitor(Display_context *pdc)
+#else /* Xlib */
+
+static bool locate_window(Display *display, int screen_number, Window window,
+                          int *px, int *py)
 {
-    int revert_to_window;
     int focused_x, focused_y;
     int dummy_x, dummy_y;
     unsigned int focused_width, focused_height, focused_border, focused_depth;
+    Window fchild_window;
+    bool located;
+
+    /* Get coords of focused window, then its width and height to move bar
+     * relative to the center of focused window */
+    expect_begin(display);
+    located = XTranslateCoordinates(display, window,
+                                    RootWindow(display, screen_number), 0, 0,
+                                    &focused_x, &focused_y, &fchild_window) &&
+              XGetGeometry(display, window, &fchild_window, &dummy_x,
+                           &dummy_y, &focused_width, &focused_height,
+                           &focused_border, &focused_depth);
+    expect_end(display);
+    if (!located)
+        return false;
 
-    Window focused_window, fchild_window;
-
-    XGetInputFocus(pdc->x.display, &focused_window, &revert_to_window);
+    print_loge("DEBUG: focused_x [%d] focused_y [%d]\n", focused_x, focused_y);
+    *px = focused_x + focused_width / 2;
+    *py = focused_y + focused_height / 2;
+    return focused_x >= 0 || focused_y >= 0;
+}
 
-    /* Get coords of focused window */
-    XTranslateCoordinates(pdc->x.display, focused_window,
-                          RootWindow(pdc->x.display, pdc->x.screen_number), 0,
-                          0, &focused_x, &focused_y, &fchild_window);
-    /* Get focused window width and height to move bar relative to
-     * the center of focused window */
-    XGetGeometry(pdc->x.display, focused_window, &fchild_window, &dummy_x,
-                 &dummy_y, &focused_width, &focused_height, &focused_border,
-                 &focused_depth);
+static bool locate_focus(Display_context *pdc, int *px, int *py)
+{
+    int revert_to_window;
+    Window focused_window;
 
-    print_loge("DEBUG: focused_x [%d] focused_y [%d]\n", focused_x, focused_y);
-    // TODO Get active "monitor" if there is no focused windows
-    /* if coordinates of active window is correct then recalculate position
-     * otherwise don't do anything with positioning and resizing */
-    if (focused_x >= 0 || focused_y >= 0)
-        move_resize_to_coords_monitor(pdc, focused_x + focused_width / 2,
-                                      focused_y + focused_height / 2);
+    XGetInputFocus(pdc->x.display, &focused_window, &revert_to_window);
+    if (focused_window == None || focused_window == PointerRoot)
+        return false;
+    return locate_window(pdc->x.display, pdc->x.screen_number,
+                         focused_window, px, py);
 }
 
-/* Move the bar to monitor with pointer */
-static void move_resize_to_pointer_monitor(Display_context *pdc)
+static bool locate_pointer(Display_context *pdc, int *px, int *py)
 {
-    int pointer_x, pointer_y, win_x, win_y;
+    int win_x, win_y;
     unsigned int p_mask;
     Window p_root, p_child;
 
-    XQueryPointer(pdc->x.display,
-                  RootWindow(pdc->x.display, pdc->x.screen_number), &p_root,
-                  &p_child, &pointer_x, &pointer_y, &win_x, &win_y, &p_mask);
-
-    move_resize_to_coords_monitor(pdc, pointer_x, pointer_y);
+    return XQueryPointer(pdc->x.display,
+                         RootWindow(pdc->x.display, pdc->x.screen_number),
+                         &p_root, &p_child, px, py, &win_x, &win_y, &p_mask);
 }
 
-static void init_text(Display_context *pdc, const Style *pconf)
+#endif /* WITH_XCB */
+
+/* Follow the active window of an EWMH window manager: called when
+ * _NET_ACTIVE_WINDOW changes, rather than querying the focus on each show */
+static void track_active_window(Display *display, int screen_number,
+                                Focus_tracker *ptracker)
 {
-    int i, str_len;
-    Depth dc_depth;
-    XGlyphInfo text_info;
-    Dynamic_string dyn_str;
+    Atom type;
+    int format;
+    unsigned long item_count, bytes_after;
+    unsigned char *data = NULL;
+    Window window = None;
+
+    if (XGetWindowProperty(display, RootWindow(display, screen_number),
+                           ptracker->atom, 0, 1, False, XA_WINDOW, &type,
+                           &format, &item_count, &bytes_after,
+                           &data) == Success &&
+        type == XA_WINDOW && item_count == 1)
+    {
+        window = *(Window *)data;
+    }
+    if (data != NULL)
+        XFree(data);
 
-    pdc->text_rendering.text_count = pconf->text_list.len;
+    if (window != ptracker->window)
+    {
+        expect_begin(display);
+        if (ptracker->window != None)
+            XSelectInput(display, ptracker->window, NoEventMask);
+        /* Moves, resizes, mapping and destruction of the window */
+        if (window != None)
+            XSelectInput(display, window, StructureNotifyMask);
+        expect_end(display);
+        ptracker->window = window;
+    }
+    ptracker->located =
+        window != None && locate_window(display, screen_number, window,
+                                        &ptracker->x, &ptracker->y);
+}
 
-    /* if no text found in conf then not init text rendering */
-    if (pdc->text_rendering.text_count == 0)
+/* Whether the window manager maintains _NET_ACTIVE_WINDOW */
+static bool supports_active_window(Display *display, int screen_number)
+{
+    Atom type;
+    int format;
+    unsigned long item_count, bytes_after;
+    unsigned char *data = NULL;
+    Atom *atoms;
+    Atom supported = XInternAtom(display, "_NET_SUPPORTED", False);
+    Atom active_window = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+    bool found = false;
+    unsigned long i;
+
+    if (XGetWindowProperty(display, RootWindow(display, screen_number),
+                           supported, 0, 4096, False, XA_ATOM, &type, &format,
+                           &item_count, &bytes_after, &data) == Success &&
+        type == XA_ATOM)
     {
-        print_loge_once("DEBUG: text_count is 0\n");
-        pdc->geometry.x.offset = 0;
-        pdc->geometry.y.offset = 0;
-        pdc->geometry.x.max = pdc->geometry.size_x;
-        pdc->geometry.y.max = pdc->geometry.size_y;
-        pdc->text_rendering.ptext = NULL;
-        return;
+        atoms = (Atom *)data;
+        for (i = 0; i < item_count && !found; i++)
+            found = atoms[i] == active_window;
     }
-    pdc->text_rendering.ptext = (Text_context *)malloc(
-        sizeof(Text_context) * pdc->text_rendering.text_count);
+    if (data != NULL)
+        XFree(data);
+    return found;
+}
 
-    dc_depth = get_display_context_depth(*pdc);
-    pdc->text_rendering.colormap = XCreateColormap(
-        pdc->x.display, RootWindow(pdc->x.display, pdc->x.screen_number),
-        dc_depth.visuals, AllocNone);
-    pdc->text_rendering.visual = dc_depth.visuals;
+/* Start following the active window, unless already done or not supported
+ * by the window manager */
+static void start_focus_tracking(X_connection *pconnection)
+{
+    Focus_tracker *ptracker = &pconnection->focus;
 
-    pdc->text_rendering.have_dynamic_strings = false;
-    for (i = 0; i < pdc->text_rendering.text_count; i++)
-    {
+    if (ptracker->enabled)
+        return;
+    ptracker->enabled = true;
+    ptracker->ewmh = supports_active_window(pconnection->display,
+                                            pconnection->screen_number);
+    print_loge("DEBUG: focus tracking with EWMH: %d\n", ptracker->ewmh);
+    if (!ptracker->ewmh)
+        return;
+
+    ptracker->atom =
+        XInternAtom(pconnection->display, "_NET_ACTIVE_WINDOW", False);
+    XSelectInput(pconnection->display,
+                 RootWindow(pconnection->display, pconnection->screen_number),
+                 PropertyChangeMask);
+    track_active_window(pconnection->display, pconnection->screen_number,
+                        ptracker);
+}
+
+/* Move the bar to monitor with focused window */
+static void move_resize_to_focused_monitor(Display_context *pdc)
+{
+    int x, y;
+
+    /* Tracked as the active window changes, queried when it cannot be
+     * located (e.g. unmapped) */
+    if (pdc->x.focus->ewmh && pdc->x.focus->located)
+    {
+        move_resize_to_coords_monitor(pdc, pdc->x.focus->x, pdc->x.focus->y);
+        return;
+    }
+
+    // TODO Get active "monitor" if there is no focused windows
+    /* if coordinates of active window is correct then recalculate position
+     * otherwise don't do anything with positioning and resizing */
+    if (locate_focus(pdc, &x, &y))
+        move_resize_to_coords_monitor(pdc, x, y);
+}
+
+/* Move the bar to monitor with pointer */
+static void move_resize_to_pointer_monitor(Display_context *pdc)
+{
+    int x, y;
+
+    if (locate_pointer(pdc, &x, &y))
+        move_resize_to_coords_monitor(pdc, x, y);
+}
+
+static void init_text(Display_context *pdc, X_connection *pconnection,
+                      const Style *pconf)
+{
+    int i, str_len;
+    Dynamic_string dyn_str;
+
+    pdc->text_rendering.text_count = pconf->text_list.len;
+    pdc->text_rendering.specs = NULL;
+    pdc->text_rendering.spec_count = 0;
+    pdc->text_rendering.spec_size = 0;
+    pdc->text_rendering.specs_valid = false;
+    pdc->text_rendering.xft_draw = NULL;
+
+    /* if no text found in conf then not init text rendering */
+    if (pdc->text_rendering.text_count == 0)
+    {
+        print_loge_once("DEBUG: text_count is 0\n");
+        pdc->geometry.x.offset = 0;
+        pdc->geometry.y.offset = 0;
+        pdc->geometry.x.max = pdc->geometry.size_x;
+        pdc->geometry.y.max = pdc->geometry.size_y;
+        pdc->text_rendering.ptext = NULL;
+        return;
+    }
+    pdc->text_rendering.ptext = (Text_context *)malloc(
+        sizeof(Text_context) * pdc->text_rendering.text_count);
+
+    pdc->text_rendering.colormap = pconnection->colormap;
+    pdc->text_rendering.visual = pconnection->depth.visuals;
+
+    pdc->text_rendering.have_dynamic_strings = false;
+    for (i = 0; i < pdc->text_rendering.text_count; i++)
+    {
         /* Copy text position data to Text_context structure */
         pdc->text_rendering.ptext[i].x.rel = pconf->text_list.ptext[i].x.rel;
         pdc->text_rendering.ptext[i].x.abs = pconf->text_list.ptext[i].x.abs;
@@ -498,26 +996,44 @@ static void init_text(Display_context *pdc, const Style *pconf)
         pdc->text_rendering.ptext[i].align.y =
             pconf->text_list.ptext[i].align.y;
 
+        pdc->text_rendering.ptext[i].string_size = 0;
+        pdc->text_rendering.ptext[i].next_string = NULL;
+        pdc->text_rendering.ptext[i].next_size = 0;
+        pdc->text_rendering.ptext[i].spec_count = 0;
+        pdc->text_rendering.ptext[i].baked = false;
+
         /*** Load and configure fonts and colors ***/
 
-        /* Load font */
-        pdc->text_rendering.ptext[i].font =
-            XftFontOpenName(pdc->x.display, pdc->x.screen_number,
-                            pconf->text_list.ptext[i].font_name);
-        if (pdc->text_rendering.ptext[i].font)
-            fprintf(stderr, "Info: Loaded font \"%s\"\n",
-                    pconf->text_list.ptext[i].font_name);
+        pdc->text_rendering.ptext[i].renderer =
+            pconf->text_list.ptext[i].renderer;
+        pdc->text_rendering.ptext[i].rgba = pconf->text_list.ptext[i].rgba;
+        if (pdc->text_rendering.ptext[i].renderer == TEXT_PIXEL)
+        {
+            /* Drawn with the colors of the bar, without any font */
+            pdc->text_rendering.ptext[i].font = NULL;
+            pdc->text_rendering.ptext[i].font_request = -1;
+        }
         else
-            fprintf(stderr, "Error: Font \"%s\" is not loaded\n",
-                    pconf->text_list.ptext[i].font_name);
-
-        /* Load color */
-        if (!XftColorAllocName(pdc->x.display, pdc->text_rendering.visual,
-                               pdc->text_rendering.colormap,
-                               pconf->text_list.ptext[i].color,
-                               &pdc->text_rendering.ptext[i].font_color))
-            fprintf(stderr, "Error: Color \"%s\" is not loaded\n",
-                    pconf->text_list.ptext[i].color);
+        {
+            /* Requested now, loaded in the background: the text appears
+             * once the font is ready */
+            pdc->text_rendering.ptext[i].font_request = font_loader_request(
+                &pconnection->fonts, pdc->x.display, pdc->x.screen_number,
+                pconf->text_list.ptext[i].font_name != NULL
+                    ? pconf->text_list.ptext[i].font_name
+                    : "");
+            pdc->text_rendering.ptext[i].font =
+                font_loader_get(&pconnection->fonts, pdc->x.display,
+                                pdc->text_rendering.ptext[i].font_request);
+
+            /* Load color */
+            if (!XftColorAllocName(pdc->x.display, pdc->text_rendering.visual,
+                                   pdc->text_rendering.colormap,
+                                   pconf->text_list.ptext[i].color,
+                                   &pdc->text_rendering.ptext[i].font_color))
+                fprintf(stderr, "Error: Color \"%s\" is not loaded\n",
+                        pconf->text_list.ptext[i].color);
+        }
 
         /* Copy string to context */
         dyn_str = generate_dyn_str(pconf->text_list.ptext[i].string);
@@ -532,15 +1048,10 @@ static void init_text(Display_context *pdc, const Style *pconf)
                    pconf->text_list.ptext[i].string);
             pdc->text_rendering.ptext[i].string[str_len] = '\0';
             pdc->text_rendering.ptext[i].is_dynamic = false;
+            pdc->text_rendering.ptext[i].changed = false;
 
             /* Calculate text sizes */
-            XftTextExtentsUtf8(
-                pdc->x.display, pdc->text_rendering.ptext[i].font,
-                (const FcChar8 *)pdc->text_rendering.ptext[i].string, str_len,
-                &text_info);
-            pdc->text_rendering.ptext[i].width = text_info.width;
-            // dc.text_rendering.ptext->height = text_info.height;
-            pdc->text_rendering.ptext[i].height = text_info.y;
+            measure_text(pdc, &pdc->text_rendering.ptext[i]);
         }
         else
         {
@@ -550,6 +1061,7 @@ static void init_text(Display_context *pdc, const Style *pconf)
                 (Dynamic_string *)malloc(sizeof(Dynamic_string));
             *(pdc->text_rendering.ptext[i].pdyn_str) = dyn_str;
             pdc->text_rendering.ptext[i].is_dynamic = true;
+            pdc->text_rendering.ptext[i].changed = false;
             pdc->text_rendering.have_dynamic_strings = true;
             pdc->text_rendering.ptext[i].string = NULL;
         }
@@ -557,167 +1069,538 @@ static void init_text(Display_context *pdc, const Style *pconf)
     compute_text_position(pdc);
 }
 
-/* PUBLIC Returns a new display context from a given configuration. If the
- * .x.display field of the returned display context is NULL, display could not
- * have been opened.*/
-Display_context init(Style conf)
+/* Distinct colors that can be drawn with a colorscheme, transparent first */
+static int fill_palette(Color *palette, Colorscheme colorscheme,
+                        const Text_rendering_context *prendering)
 {
-    Display_context dc;
-    Depth dc_depth;
-    Window root;
-    int topleft_x;
-    int topleft_y;
-    XSetWindowAttributes window_attributes;
-    static long window_attributes_flags =
-        CWColormap | CWBorderPixel | CWOverrideRedirect;
-    Atom atom_net_wm_window_type, atom_net_wm_window_type_desktop;
+    Color transparent = {.red = 0x0, .green = 0x0, .blue = 0x0, .alpha = 0x0};
+    Colors schemes[] = {colorscheme.normal, colorscheme.overflow,
+                        colorscheme.alt, colorscheme.altoverflow};
+    Color colors[PALETTE_SIZE - PIXEL_COLORS_MAX];
+    const Text_context *ptext;
+    int count = 0;
+    int i, j;
+
+    colors[0] = transparent;
+    for (i = 0; i < 4; i++)
+    {
+        colors[1 + 3 * i] = schemes[i].fg;
+        colors[2 + 3 * i] = schemes[i].bg;
+        colors[3 + 3 * i] = schemes[i].border;
+    }
 
-    int xdbe_major_version, xdbe_minor_version;
+    for (i = 0; i < PALETTE_SIZE - PIXEL_COLORS_MAX; i++)
+    {
+        for (j = 0; j < count && !same_color(palette[j], colors[i]); j++)
+            ;
+        if (j == count)
+            palette[count++] = colors[i];
+    }
 
-    dc.x.display = XOpenDisplay(NULL);
-    if (dc.x.display != NULL)
+    /* The pixel font is drawn like the bar */
+    for (i = 0; i < prendering->text_count; i++)
     {
-        if (XdbeQueryExtension(dc.x.display, &xdbe_major_version,
-                               &xdbe_minor_version))
-        {
-            print_loge("DEBUG: XDBE version %d.%d.\n", xdbe_major_version,
-                       xdbe_minor_version);
-        }
-        else
+        ptext = &prendering->ptext[i];
+        if (ptext->renderer != TEXT_PIXEL)
+            continue;
+        for (j = 0; j < count && !same_color(palette[j], ptext->rgba); j++)
+            ;
+        if (j < count)
+            continue;
+        if (count == PALETTE_SIZE)
         {
-            fprintf(stderr, "ERROR: XDBE is not supported.\n");
-            exit(2);
+            fprintf(stderr,
+                    "Error: Texts drawn with the pixel font have more than "
+                    "%d colors besides the colorscheme\n",
+                    PIXEL_COLORS_MAX);
+            break;
         }
+        palette[count++] = ptext->rgba;
+    }
+    return count;
+}
 
-        dc.x.screen_number = DefaultScreen(dc.x.display);
-        dc.x.screen = ScreenOfDisplay(dc.x.display, dc.x.screen_number);
-        root = RootWindow(dc.x.display, dc.x.screen_number);
+/* Built in renderers, the first available one being the fallback */
+static const Renderer *const renderers[] = {
+#ifdef WITH_XRENDER
+    &renderer_xrender,
+#endif
+#ifdef WITH_SHM
+    &renderer_shm,
+#endif
+    &renderer_xlib};
+
+#define RENDERER_COUNT ((int)(sizeof(renderers) / sizeof(renderers[0])))
+
+/* Frames drawn by each renderer when looking for the fastest one */
+#define PROBE_FRAMES 16
+#define PROBE_WIDTH 300
+#define PROBE_HEIGHT 40
+
+/* PUBLIC Returns the renderer of a given name, or NULL if it is not built
+ * in */
+const Renderer *find_renderer(const char *name)
+{
+    int i;
 
-        dc_depth = get_display_context_depth(dc);
+    for (i = 0; i < RENDERER_COUNT; i++)
+    {
+        if (strcmp(renderers[i]->name, name) == 0)
+            return renderers[i];
+    }
+    return NULL;
+}
 
-        window_attributes.colormap =
-            XCreateColormap(dc.x.display, root, dc_depth.visuals, AllocNone);
-        window_attributes.border_pixel = 0;
-        window_attributes.override_redirect = True;
+/* PUBLIC Print the names of the renderers built in */
+void print_renderers(FILE *stream)
+{
+    int i;
 
-        /* Get bar position from conf */
-        if (strcmp(conf.monitor, MONITOR_RELATIVE_FOCUS) == 0)
-            dc.geometry.bar_position = POSITION_RELATIVE_FOCUS;
-        else if (strcmp(conf.monitor, MONITOR_RELATIVE_POINTER) == 0)
-            dc.geometry.bar_position = POSITION_RELATIVE_POINTER;
-        else if (strcmp(conf.monitor, MONITOR_COMBINED) == 0)
-            dc.geometry.bar_position = POSITION_COMBINED;
-        else
-            dc.geometry.bar_position = POSITION_SPECIFIED;
+    for (i = 0; i < RENDERER_COUNT; i++)
+        fprintf(stream, i == 0 ? "%s" : " %s", renderers[i]->name);
+}
 
-        switch (dc.geometry.bar_position)
+/* Whether a compositing manager is running, in which case only renderers
+ * drawing with an alpha channel are worth considering */
+static bool compositing(Display *display, int screen_number)
+{
+    char name[32];
+
+    snprintf(name, sizeof(name), "_NET_WM_CM_S%d", screen_number);
+    return XGetSelectionOwner(display, XInternAtom(display, name, False)) !=
+           None;
+}
+
+static double elapsed_ms(struct timespec start, struct timespec end)
+{
+    return (end.tv_sec - start.tv_sec) * 1e3 +
+           (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+/* Milliseconds taken by a renderer to draw bar-like frames on a pixmap, or a
+ * negative value if it cannot be used */
+static double probe_renderer(Display *display, int screen_number,
+                             const Renderer *prenderer)
+{
+    Window root = RootWindow(display, screen_number);
+    Depth depth = prenderer->get_display_depth(display, screen_number);
+    Colormap colormap =
+        XCreateColormap(display, root, depth.visuals, AllocNone);
+    Color palette[] = {{0xff, 0xff, 0xff, 0xff}, {0x00, 0x00, 0x00, 0xff}};
+    XRectangle rectangles[2];
+    struct timespec start, end;
+    double duration = -1;
+    int i;
+    X_context xc = {.display = display,
+                    .screen_number = screen_number,
+                    .screen = ScreenOfDisplay(display, screen_number),
+                    .window = None,
+                    .depth = depth.depth,
+                    .renderer = prenderer};
+
+    xc.back_buffer =
+        XCreatePixmap(display, root, PROBE_WIDTH, PROBE_HEIGHT, depth.depth);
+    xc.backend = prenderer->init(xc, depth.visuals, colormap, palette, 2);
+    if (xc.backend != NULL)
+    {
+        /* The first frame prepares what is created lazily */
+        for (i = -1; i < PROBE_FRAMES; i++)
         {
-        case POSITION_RELATIVE_FOCUS:
-        case POSITION_RELATIVE_POINTER:
-            /* Bar position and sizes will be recalculated every time before
-             * showing, so the code just init position and sizes like for
-             * combined surface */
-            set_combined_position(&dc);
-            break;
-        case POSITION_COMBINED:
-            set_combined_position(&dc);
-            break;
-        case POSITION_SPECIFIED:
-            set_specified_position(&dc, &conf);
-            break;
-        default:
-            fprintf(stderr, "Error: in switch position\n");
-            break;
+            if (i == 0)
+            {
+                XSync(display, False);
+                clock_gettime(CLOCK_MONOTONIC, &start);
+            }
+            rectangles[0] = (XRectangle){0, 0, PROBE_WIDTH, PROBE_HEIGHT};
+            rectangles[1] = (XRectangle){
+                4, 4, (PROBE_WIDTH - 8) * (i + 1) / PROBE_FRAMES,
+                PROBE_HEIGHT - 8};
+            prenderer->fill_rectangles(xc, xc.back_buffer, 1, rectangles, 1);
+            prenderer->fill_rectangles(xc, xc.back_buffer, 0, rectangles + 1,
+                                       1);
+            prenderer->flush(xc);
         }
+        XSync(display, False);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        duration = elapsed_ms(start, end);
+        prenderer->destroy(xc);
+    }
+    XFreePixmap(display, xc.back_buffer);
+    XFreeColormap(display, colormap);
+    return duration;
+}
 
-        /* Write bar position relative data to X_context */
-        dc.geometry.x.rel = conf.x.rel;
-        dc.geometry.x.abs = conf.x.abs;
-        dc.geometry.y.rel = conf.y.rel;
-        dc.geometry.y.abs = conf.y.abs;
+/* The fastest renderer available on the display */
+static const Renderer *select_renderer(Display *display, int screen_number)
+{
+    const Renderer *pfastest = NULL;
+    double fastest_duration = 0;
+    double duration;
+    bool need_alpha = compositing(display, screen_number);
+    int i;
 
-        dc.geometry.outline = conf.outline;
-        dc.geometry.border = conf.border;
-        dc.geometry.padding = conf.padding;
-        dc.geometry.thickness = conf.thickness;
-        dc.geometry.orientation = conf.orientation;
-        dc.geometry.length_dynamic.rel = conf.length.rel;
-        dc.geometry.length_dynamic.abs = conf.length.abs;
+    for (i = 0; i < RENDERER_COUNT; i++)
+    {
+        if (!renderers[i]->available(display, screen_number) ||
+            (need_alpha &&
+             renderers[i]->get_display_depth(display, screen_number).depth !=
+                 32))
+            continue;
 
-        dc.geometry.x.offset = 0;
-        dc.geometry.y.offset = 0;
+        duration = probe_renderer(display, screen_number, renderers[i]);
+        print_loge("DEBUG: renderer %s: %.3f ms\n", renderers[i]->name,
+                   duration);
+        if (duration >= 0 && (pfastest == NULL || duration < fastest_duration))
+        {
+            pfastest = renderers[i];
+            fastest_duration = duration;
+        }
+    }
 
-        dc.geometry.fat_layer =
-            dc.geometry.padding + dc.geometry.border + dc.geometry.outline;
+    /* Core requests always work */
+    return pfastest != NULL ? pfastest : &renderer_xlib;
+}
 
-        compute_geometry(&dc, &topleft_x, &topleft_y);
+/* Query the monitors of the screen and their names in two round trips */
+static void update_monitors(Display *display, int screen_number,
+                            Monitor_list *plist)
+{
+    XRRMonitorInfo *monitor_sizes;
+    Atom *atoms;
+    char **names;
+    int count;
+    int i;
 
-        /* init text context */
-        init_text(&dc, &conf);
-        print_loge_once("DEBUG: init_text successful\n");
+    free(plist->monitors);
+    plist->monitors = NULL;
+    plist->count = 0;
 
-        /* Creation of the window */
-        dc.x.window =
-            XCreateWindow(dc.x.display, root, topleft_x - dc.geometry.x.offset,
-                          topleft_y - dc.geometry.y.offset,
-                          dc.geometry.x.offset + dc.geometry.x.max,
-                          dc.geometry.y.offset + dc.geometry.y.max, 0,
-                          dc_depth.depth, InputOutput, dc_depth.visuals,
-                          window_attributes_flags, &window_attributes);
-        print_loge_once("DEBUG: Window created\n");
+    monitor_sizes = XRRGetMonitors(
+        display, RootWindow(display, screen_number), 0, &count);
+    if (monitor_sizes == NULL)
+        return;
+    plist->monitors = (MonitorInfo *)calloc(count, sizeof(MonitorInfo));
+    atoms = (Atom *)malloc(count * sizeof(Atom));
+    names = (char **)calloc(count, sizeof(char *));
+    if (plist->monitors != NULL && atoms != NULL && names != NULL)
+    {
+        for (i = 0; i < count; i++)
+            atoms[i] = monitor_sizes[i].name;
+        XGetAtomNames(display, atoms, count, names);
+        for (i = 0; i < count; i++)
+        {
+            if (names[i] != NULL)
+            {
+                snprintf(plist->monitors[i].name, LNAME_MONITOR, "%s",
+                         names[i]);
+                XFree(names[i]);
+            }
+            plist->monitors[i].x = monitor_sizes[i].x;
+            plist->monitors[i].y = monitor_sizes[i].y;
+            plist->monitors[i].width = monitor_sizes[i].width;
+            plist->monitors[i].height = monitor_sizes[i].height;
+            print_loge("DEBUG: monitor %s %dx%d+%d+%d\n",
+                       plist->monitors[i].name, plist->monitors[i].width,
+                       plist->monitors[i].height, plist->monitors[i].x,
+                       plist->monitors[i].y);
+        }
+        plist->count = count;
+    }
+    free(names);
+    free(atoms);
+    XRRFreeMonitors(monitor_sizes);
+}
 
-        /* Create second buffer */
-        dc.x.back_buffer =
-            XdbeAllocateBackBufferName(dc.x.display, dc.x.window, 0);
-        print_loge_once("DEBUG: Back buffer allocated successfylly\n");
+/* PUBLIC Returns a connection to the X server shared by all the bars. If the
+ * .display field of the returned connection is NULL, display could not have
+ * been opened. */
+X_connection connect_display(const char *renderer_name)
+{
+    X_connection connection;
+    int xdbe_major_version, xdbe_minor_version;
+    int randr_error_base;
+
+    connection.display = XOpenDisplay(NULL);
+    if (connection.display != NULL)
+    {
+        XSetErrorHandler(handle_x_error);
+
+        if (XdbeQueryExtension(connection.display, &xdbe_major_version,
+                               &xdbe_minor_version))
+        {
+            print_loge("DEBUG: XDBE version %d.%d.\n", xdbe_major_version,
+                       xdbe_minor_version);
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: XDBE is not supported.\n");
+            exit(2);
+        }
 
-        if (dc.text_rendering.text_count != 0)
+        connection.screen_number = DefaultScreen(connection.display);
+        connection.screen =
+            ScreenOfDisplay(connection.display, connection.screen_number);
+        if (strcmp(renderer_name, "auto") == 0)
         {
-            dc.text_rendering.xft_draw = XftDrawCreate(
-                dc.x.display, dc.x.back_buffer, dc.text_rendering.visual,
-                dc.text_rendering.colormap);
-            print_loge_once("DEBUG: XFT Draw created successfully\n");
+            connection.renderer = select_renderer(connection.display,
+                                                  connection.screen_number);
         }
         else
         {
-            print_loge_once(
-                "DEBUG: XFT Draw is not created, text_count is 0\n");
+            connection.renderer = find_renderer(renderer_name);
+            if (!connection.renderer->available(connection.display,
+                                                connection.screen_number))
+            {
+                fprintf(stderr, "Error: the %s renderer is not supported.\n",
+                        renderer_name);
+                exit(2);
+            }
+        }
+        print_loge("DEBUG: %s renderer.\n", connection.renderer->name);
+        connection.depth = connection.renderer->get_display_depth(
+            connection.display, connection.screen_number);
+        connection.colormap = XCreateColormap(
+            connection.display,
+            RootWindow(connection.display, connection.screen_number),
+            connection.depth.visuals, AllocNone);
+
+        /* Shared by the texts of all the bars */
+        connection.layouts = (Layout_cache *)malloc(sizeof(Layout_cache));
+        if (connection.layouts == NULL)
+        {
+            fprintf(stderr, "Error: Cannot allocate the text layouts\n");
+            exit(EXIT_FAILURE);
         }
-        // dc.text_rendering.xft_draw =
-        //     XftDrawCreate(dc.x.display, dc.x.window,
-        //     dc.text_rendering.visual,
-        //                   dc.text_rendering.colormap);
+        layout_cache_init(connection.layouts);
 
-        /* Set a WM_CLASS for the window */
-        XClassHint *class_hint = XAllocClassHint();
-        if (class_hint != NULL)
+        /* Fonts are matched in the background once the bars are ready */
+        if (!font_loader_init(&connection.fonts))
         {
-            class_hint->res_name = DEFAULT_CONFIG_APPNAME;
-            class_hint->res_class = DEFAULT_CONFIG_APPNAME;
-            XSetClassHint(dc.x.display, dc.x.window, class_hint);
-            XFree(class_hint);
+            fprintf(stderr, "Error: Cannot create the font loader\n");
+            exit(EXIT_FAILURE);
         }
-        print_loge_once("DEBUG: WM_CLASS set successfully\n");
 
-        /* Set _NET_WINDOW_TYPE to _NET_WM_WINDOW_TYPE_DESKTOP to prevent
-         * rendering compositor borders */
-        atom_net_wm_window_type =
-            XInternAtom(dc.x.display, "_NET_WM_WINDOW_TYPE", False);
-        atom_net_wm_window_type_desktop =
-            XInternAtom(dc.x.display, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
-        XChangeProperty(dc.x.display, dc.x.window, atom_net_wm_window_type,
-                        XA_ATOM, 32, PropModeReplace,
-                        (unsigned char *)&atom_net_wm_window_type_desktop, 1);
-        print_loge_once(
-            "DEBUG: Set _NET_WINDOW_TYPE to _NET_WM_WINDOWS_TYPE_DESKTOP\n");
+        /* Followed once a bar is shown relative to the focus */
+        connection.focus.enabled = false;
+        connection.focus.ewmh = false;
+        connection.focus.atom = None;
+        connection.focus.window = None;
+        connection.focus.located = false;
+
+        /* Monitors are cached and refreshed on RandR events */
+        connection.monitors.monitors = NULL;
+        connection.monitors.count = 0;
+        if (XRRQueryExtension(connection.display,
+                              &connection.randr_event_base,
+                              &randr_error_base))
+        {
+            XRRSelectInput(
+                connection.display,
+                RootWindow(connection.display, connection.screen_number),
+                RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask |
+                    RROutputChangeNotifyMask);
+        }
+        else
+        {
+            connection.randr_event_base = -1;
+        }
+        update_monitors(connection.display, connection.screen_number,
+                        &connection.monitors);
+    }
+    return connection;
+}
 
-        /* The new window is not mapped yet */
-        dc.x.mapped = False;
+/* PUBLIC Close the connection once every display context is destroyed */
+void disconnect_display(X_connection *pconnection)
+{
+    print_loge("DEBUG: text layouts: %lu hits, %lu misses\n",
+               pconnection->layouts->hits, pconnection->layouts->misses);
+    layout_cache_free(pconnection->layouts);
+    free(pconnection->layouts);
+    font_loader_free(&pconnection->fonts, pconnection->display);
+    free(pconnection->monitors.monitors);
+    XFreeColormap(pconnection->display, pconnection->colormap);
+    XCloseDisplay(pconnection->display);
+}
 
-        /* Colorscheme */
-        dc.colorscheme = conf.colorscheme;
+/* PUBLIC Returns a new display context from a given configuration on an open
+ * connection */
+Display_context init(X_connection *pconnection, Style conf)
+{
+    Display_context dc;
+    Window root;
+    int topleft_x;
+    int topleft_y;
+    int i;
+    XSetWindowAttributes window_attributes;
+    static long window_attributes_flags =
+        CWColormap | CWBorderPixel | CWOverrideRedirect | CWEventMask;
+    Atom atom_net_wm_window_type, atom_net_wm_window_type_desktop;
+
+    dc.x.display = pconnection->display;
+    dc.x.screen_number = pconnection->screen_number;
+    dc.x.screen = pconnection->screen;
+    dc.x.depth = pconnection->depth.depth;
+    dc.x.visual = pconnection->depth.visuals;
+    dc.x.colormap = pconnection->colormap;
+    dc.x.renderer = pconnection->renderer;
+    dc.x.monitors = &pconnection->monitors;
+    dc.x.focus = &pconnection->focus;
+    dc.x.layouts = pconnection->layouts;
+    root = RootWindow(dc.x.display, dc.x.screen_number);
+
+    window_attributes.colormap = pconnection->colormap;
+    window_attributes.border_pixel = 0;
+    window_attributes.override_redirect = True;
+    window_attributes.event_mask = ExposureMask;
+
+    /* Get bar position from conf */
+    if (strcmp(conf.monitor, MONITOR_RELATIVE_FOCUS) == 0)
+        dc.geometry.bar_position = POSITION_RELATIVE_FOCUS;
+    else if (strcmp(conf.monitor, MONITOR_RELATIVE_POINTER) == 0)
+        dc.geometry.bar_position = POSITION_RELATIVE_POINTER;
+    else if (strcmp(conf.monitor, MONITOR_COMBINED) == 0)
+        dc.geometry.bar_position = POSITION_COMBINED;
+    else
+        dc.geometry.bar_position = POSITION_SPECIFIED;
+
+    switch (dc.geometry.bar_position)
+    {
+    case POSITION_RELATIVE_FOCUS:
+        start_focus_tracking(pconnection);
+        /* fall through */
+    case POSITION_RELATIVE_POINTER:
+        /* Bar position and sizes will be recalculated every time before
+         * showing, so the code just init position and sizes like for
+         * combined surface */
+        set_combined_position(&dc);
+        break;
+    case POSITION_COMBINED:
+        set_combined_position(&dc);
+        break;
+    case POSITION_SPECIFIED:
+        set_specified_position(&dc, &conf);
+        break;
+    default:
+        fprintf(stderr, "Error: in switch position\n");
+        break;
     }
 
+    /* Write bar position relative data to X_context */
+    dc.geometry.x.rel = conf.x.rel;
+    dc.geometry.x.abs = conf.x.abs;
+    dc.geometry.y.rel = conf.y.rel;
+    dc.geometry.y.abs = conf.y.abs;
+
+    dc.geometry.outline = conf.outline;
+    dc.geometry.border = conf.border;
+    dc.geometry.padding = conf.padding;
+    dc.geometry.thickness = conf.thickness;
+    dc.geometry.orientation = conf.orientation;
+    dc.geometry.length_dynamic.rel = conf.length.rel;
+    dc.geometry.length_dynamic.abs = conf.length.abs;
+
+    dc.geometry.x.offset = 0;
+    dc.geometry.y.offset = 0;
+
+    dc.geometry.fat_layer =
+        dc.geometry.padding + dc.geometry.border + dc.geometry.outline;
+
+    compute_geometry(&dc, &topleft_x, &topleft_y);
+
+    /* init text context */
+    init_text(&dc, pconnection, &conf);
+    print_loge_once("DEBUG: init_text successful\n");
+
+    /* Creation of the window */
+    dc.x.area.x = topleft_x - dc.geometry.x.offset;
+    dc.x.area.y = topleft_y - dc.geometry.y.offset;
+    dc.x.area.width = dc.geometry.x.offset + dc.geometry.x.max;
+    dc.x.area.height = dc.geometry.y.offset + dc.geometry.y.max;
+    dc.x.window = XCreateWindow(
+        dc.x.display, root, dc.x.area.x, dc.x.area.y, dc.x.area.width,
+        dc.x.area.height, 0, pconnection->depth.depth, InputOutput,
+        pconnection->depth.visuals, window_attributes_flags,
+        &window_attributes);
+    print_loge_once("DEBUG: Window created\n");
+
+    /* Create second buffer */
+    dc.x.back_buffer = XdbeAllocateBackBufferName(dc.x.display, dc.x.window, 0);
+    print_loge_once("DEBUG: Back buffer allocated successfylly\n");
+
+    for (i = 0; i < dc.text_rendering.text_count &&
+                dc.text_rendering.ptext[i].renderer != TEXT_FONT;
+         i++)
+        ;
+    if (i < dc.text_rendering.text_count)
+    {
+        dc.text_rendering.xft_draw =
+            XftDrawCreate(dc.x.display, dc.x.back_buffer,
+                          dc.text_rendering.visual, dc.text_rendering.colormap);
+        print_loge_once("DEBUG: XFT Draw created successfully\n");
+    }
+    else
+    {
+        print_loge_once("DEBUG: XFT Draw is not created, no text uses a "
+                        "font\n");
+    }
+    // dc.text_rendering.xft_draw =
+    //     XftDrawCreate(dc.x.display, dc.x.window,
+    //     dc.text_rendering.visual,
+    //                   dc.text_rendering.colormap);
+
+    /* Set a WM_CLASS for the window */
+    XClassHint *class_hint = XAllocClassHint();
+    if (class_hint != NULL)
+    {
+        class_hint->res_name = DEFAULT_CONFIG_APPNAME;
+        class_hint->res_class = DEFAULT_CONFIG_APPNAME;
+        XSetClassHint(dc.x.display, dc.x.window, class_hint);
+        XFree(class_hint);
+    }
+    print_loge_once("DEBUG: WM_CLASS set successfully\n");
+
+    /* Set _NET_WINDOW_TYPE to _NET_WM_WINDOW_TYPE_DESKTOP to prevent
+     * rendering compositor borders */
+    atom_net_wm_window_type =
+        XInternAtom(dc.x.display, "_NET_WM_WINDOW_TYPE", False);
+    atom_net_wm_window_type_desktop =
+        XInternAtom(dc.x.display, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
+    XChangeProperty(dc.x.display, dc.x.window, atom_net_wm_window_type,
+                    XA_ATOM, 32, PropModeReplace,
+                    (unsigned char *)&atom_net_wm_window_type_desktop, 1);
+    print_loge_once(
+        "DEBUG: Set _NET_WINDOW_TYPE to _NET_WM_WINDOWS_TYPE_DESKTOP\n");
+
+    /* The new window is not mapped yet */
+    dc.x.mapped = False;
+    dc.frame.valid = false;
+
+    /* Empty bars are rendered when first needed */
+    for (i = 0; i < STATE_COUNT; i++)
+        dc.frame_cache.pixmaps[i] = None;
+    dc.frame_cache.gc = XCreateGC(dc.x.display, dc.x.window, 0, NULL);
+    XSetGraphicsExposures(dc.x.display, dc.frame_cache.gc, False);
+    dc.frame_cache.length = -1;
+
+    /* Colorscheme */
+    dc.colorscheme = conf.colorscheme;
+    dc.palette_size =
+        fill_palette(dc.palette, dc.colorscheme, &dc.text_rendering);
+
+    /* Rendering resources, created once for all the frames */
+    dc.x.backend = dc.x.renderer->init(dc.x, dc.x.visual, dc.x.colormap,
+                                       dc.palette, dc.palette_size);
+    if (dc.x.backend == NULL)
+    {
+        fprintf(stderr, "Error: Cannot initialize the rendering backend\n");
+        exit(EXIT_FAILURE);
+    }
+    dc.idle.released = false;
+    dc.idle.xft_draw = dc.text_rendering.xft_draw != NULL;
+    dc.idle.count = 0;
+    dc.idle.rewarm_ms = 0;
+
     print_loge_once("DEBUG: finish initialization\n");
     return dc;
 }
@@ -733,38 +1616,499 @@ void display_context_destroy(Display_context *pdc)
             free_dyn_str(pdc->text_rendering.ptext[i].pdyn_str);
             free(pdc->text_rendering.ptext[i].pdyn_str);
         }
+        free(pdc->text_rendering.ptext[i].string);
+        free(pdc->text_rendering.ptext[i].next_string);
+        if (pdc->text_rendering.ptext[i].renderer == TEXT_FONT)
+            XftColorFree(pdc->x.display, pdc->text_rendering.visual,
+                         pdc->text_rendering.colormap,
+                         &pdc->text_rendering.ptext[i].font_color);
+        /* Fonts are reference counted by Xft and shared between bars */
+        if (pdc->text_rendering.ptext[i].font != NULL)
+            XftFontClose(pdc->x.display, pdc->text_rendering.ptext[i].font);
+    }
+    free(pdc->text_rendering.ptext);
+    free(pdc->text_rendering.specs);
+
+    if (pdc->idle.count > 0)
+    {
+        print_loge("DEBUG: resources released %d times, recreated in %.3f ms "
+                   "on average\n",
+                   pdc->idle.count, pdc->idle.rewarm_ms / pdc->idle.count);
+    }
+
+    if (pdc->text_rendering.xft_draw != NULL)
+        XftDrawDestroy(pdc->text_rendering.xft_draw);
+    if (!pdc->idle.released)
+    {
+        pdc->x.renderer->destroy(pdc->x);
+        XdbeDeallocateBackBufferName(pdc->x.display, pdc->x.back_buffer);
+    }
+    invalidate_frame_cache(pdc);
+    XFreeGC(pdc->x.display, pdc->frame_cache.gc);
+    XDestroyWindow(pdc->x.display, pdc->x.window);
+}
+
+/* Display the back buffer. Its content is kept as is so that the window can
+ * be repaired at any time by swapping again. */
+static void swap_buffers(Display_context *pdc)
+{
+    XdbeSwapInfo swap_info;
+    swap_info.swap_window = pdc->x.window;
+    swap_info.swap_action = XdbeCopied;
+    XdbeSwapBuffers(pdc->x.display, &swap_info, 1);
+}
+
+/* Whether two frames differ only by their content and dynamic texts */
+static bool same_layout(Frame_state a, Frame_state b)
+{
+    return a.valid && b.valid && a.state == b.state && a.length == b.length &&
+           a.width == b.width && a.height == b.height &&
+           a.x_offset == b.x_offset && a.y_offset == b.y_offset;
+}
+
+/* Add a rectangle to repaint. Returns false if there are too many. */
+static bool add_damage(XRectangle *damage, int *pcount, int x, int y, int w,
+                       int h)
+{
+    if (w <= 0 || h <= 0)
+        return true;
+    if (*pcount == DAMAGE_MAX)
+        return false;
+    damage[(*pcount)++] =
+        (XRectangle){.x = x, .y = y, .width = w, .height = h};
+    return true;
+}
+
+/* Area of the window covered by a text */
+static XRectangle text_box(const Display_context *pdc, int i)
+{
+    const Text_context *ptext = &pdc->text_rendering.ptext[i];
+    return (XRectangle){
+        .x = ptext->pos.x + pdc->geometry.x.offset - ptext->extents.x,
+        .y = ptext->pos.y + pdc->geometry.y.offset - ptext->extents.y,
+        .width = ptext->extents.width,
+        .height = ptext->extents.height};
+}
+
+/* Rectangles to repaint to go from the frame on display to a new one with the
+ * same layout: the strip between the old and new fill lengths and the boxes
+ * of the texts that changed. Returns false if the whole window must be
+ * repainted instead. */
+static bool compute_damage(const Display_context *pdc, Frame_state frame,
+                           XRectangle *damage, int *pcount)
+{
+    Geometry_context g = pdc->geometry;
+    int inner = g.outline + g.border;
+    int content = inner + g.padding;
+    int low, high;
+    int i;
+    bool fits = true;
+    XRectangle box;
+
+    *pcount = 0;
+    if (frame.proportional || pdc->frame.proportional)
+    {
+        /* The separator may lie in the padding */
+        if (frame.proportional != pdc->frame.proportional ||
+            frame.filled_length != pdc->frame.filled_length)
+            fits = add_damage(damage, pcount, inner + g.x.offset,
+                              inner + g.y.offset, size_x(g) + 2 * g.padding,
+                              size_y(g) + 2 * g.padding);
+    }
+    else if (frame.filled_length != pdc->frame.filled_length)
+    {
+        low = frame.filled_length < pdc->frame.filled_length
+                  ? frame.filled_length
+                  : pdc->frame.filled_length;
+        high = frame.filled_length + pdc->frame.filled_length - low;
+        if (g.orientation == HORIZONTAL)
+            fits = add_damage(damage, pcount, content + low + g.x.offset,
+                              content + g.y.offset, high - low, g.thickness);
         else
+            fits = add_damage(damage, pcount, content + g.x.offset,
+                              content + g.length - high + g.y.offset,
+                              g.thickness, high - low);
+    }
+
+    for (i = 0; i < pdc->text_rendering.text_count && fits; i++)
+    {
+        box = text_box(pdc, i);
+        if (pdc->text_rendering.ptext[i].changed ||
+            box.x != pdc->text_rendering.ptext[i].box.x ||
+            box.y != pdc->text_rendering.ptext[i].box.y ||
+            box.width != pdc->text_rendering.ptext[i].box.width ||
+            box.height != pdc->text_rendering.ptext[i].box.height)
         {
-            free(pdc->text_rendering.ptext[i].string);
+            fits = add_damage(damage, pcount,
+                              pdc->text_rendering.ptext[i].box.x,
+                              pdc->text_rendering.ptext[i].box.y,
+                              pdc->text_rendering.ptext[i].box.width,
+                              pdc->text_rendering.ptext[i].box.height) &&
+                   add_damage(damage, pcount, box.x, box.y, box.width,
+                              box.height);
         }
-        XftColorFree(pdc->x.display, pdc->text_rendering.visual,
-                     pdc->text_rendering.colormap,
-                     &pdc->text_rendering.ptext[i].font_color);
     }
-    free(pdc->text_rendering.ptext);
+    return fits;
+}
 
-    if (pdc->text_rendering.text_count != 0)
-        XftDrawDestroy(pdc->text_rendering.xft_draw);
-    XdbeDeallocateBackBufferName(pdc->x.display, pdc->x.back_buffer);
+/* Point the Xft draw at a drawable. Xft frees its picture on every change,
+ * so this is only done when the target actually differs. */
+static void set_text_target(Display_context *pdc, Drawable drawable)
+{
+    if (XftDrawDrawable(pdc->text_rendering.xft_draw) != drawable)
+        XftDrawChange(pdc->text_rendering.xft_draw, drawable);
+}
+
+static bool same_text_color(const XftColor *a, const XftColor *b)
+{
+    return a->pixel == b->pixel && a->color.red == b->color.red &&
+           a->color.green == b->color.green &&
+           a->color.blue == b->color.blue && a->color.alpha == b->color.alpha;
+}
+
+/* Whether a static text can be drawn once in the empty bars: texts are drawn
+ * over the content, which it must not overlap */
+static bool bakeable(const Display_context *pdc, int i)
+{
+    Geometry_context g = pdc->geometry;
+    int inner = g.outline + g.border;
+    XRectangle box = text_box(pdc, i);
+
+    if (pdc->text_rendering.ptext[i].is_dynamic)
+        return false;
+    return box.x >= inner + g.x.offset + size_x(g) + 2 * g.padding ||
+           box.y >= inner + g.y.offset + size_y(g) + 2 * g.padding ||
+           box.x + box.width <= inner + g.x.offset ||
+           box.y + box.height <= inner + g.y.offset;
+}
 
-    XCloseDisplay(pdc->x.display);
+/* Resolve the texts to positioned glyphs of their fonts, in the order of
+ * the texts, and tell whether other texts are to be baked. Returns false if
+ * memory runs out. */
+static bool resolve_glyphs(Display_context *pdc, bool *prebake)
+{
+    Text_rendering_context *prendering = &pdc->text_rendering;
+    Text_context *ptext;
+    const Text_layout *playout;
+    XftGlyphFontSpec *pspec;
+    bool baked;
+    int size;
+    int i, j;
+
+    prendering->spec_count = 0;
+    for (i = 0; i < prendering->text_count; i++)
+    {
+        ptext = &prendering->ptext[i];
+        ptext->first_spec = prendering->spec_count;
+        ptext->spec_count = 0;
+        if (ptext->string == NULL)
+            continue;
+        baked = bakeable(pdc, i);
+        *prebake = *prebake || baked != ptext->baked;
+        ptext->baked = baked;
+        if (ptext->renderer == TEXT_PIXEL || ptext->font == NULL)
+            continue;
+
+        playout = layout_lookup(pdc->x.layouts, pdc->x.display, ptext->font,
+                                ptext->string);
+        if (playout == NULL)
+            return false;
+
+        if (prendering->spec_count + playout->glyph_count >
+            prendering->spec_size)
+        {
+            size = prendering->spec_size == 0 ? 64 : prendering->spec_size;
+            while (size < prendering->spec_count + playout->glyph_count)
+                size *= 2;
+            pspec = (XftGlyphFontSpec *)realloc(
+                prendering->specs, size * sizeof(XftGlyphFontSpec));
+            if (pspec == NULL)
+                return false;
+            prendering->specs = pspec;
+            prendering->spec_size = size;
+        }
+
+        ptext->first_spec = prendering->spec_count;
+        ptext->spec_count = playout->glyph_count;
+        for (j = 0; j < playout->glyph_count; j++)
+        {
+            pspec = &prendering->specs[ptext->first_spec + j];
+            pspec->font = ptext->font;
+            pspec->glyph = playout->glyphs[j];
+            pspec->x = ptext->pos.x + pdc->geometry.x.offset +
+                       playout->positions[j].x;
+            pspec->y = ptext->pos.y + pdc->geometry.y.offset +
+                       playout->positions[j].y;
+        }
+        prendering->spec_count += ptext->spec_count;
+    }
+    print_loge("DEBUG: %d glyphs resolved\n", prendering->spec_count);
+    return true;
+}
+
+/* Resolve the glyphs of the texts, rendering the empty bars again if other
+ * texts are to be baked in. Returns false if memory runs out, in which case
+ * no text is baked. */
+static bool build_glyph_specs(Display_context *pdc)
+{
+    bool rebake = false;
+    int i;
+
+    if (!resolve_glyphs(pdc, &rebake))
+    {
+        for (i = 0; i < pdc->text_rendering.text_count; i++)
+            pdc->text_rendering.ptext[i].baked = false;
+        invalidate_frame_cache(pdc);
+        return false;
+    }
+    if (rebake)
+        invalidate_frame_cache(pdc);
+    pdc->text_rendering.specs_valid = true;
+    return true;
+}
+
+/* Draw either the baked texts or the others on the target of the Xft draw,
+ * with one request per run of consecutive texts of the same color */
+static void draw_glyph_specs(Display_context *pdc, bool baked)
+{
+    Text_rendering_context *prendering = &pdc->text_rendering;
+    const Text_context *ptext;
+    const XftColor *pcolor = NULL;
+    int first = 0;
+    int count = 0;
+    int i;
+
+    for (i = 0; i <= prendering->text_count; i++)
+    {
+        ptext = i < prendering->text_count ? &prendering->ptext[i] : NULL;
+        if (ptext != NULL && (ptext->baked != baked || ptext->spec_count == 0))
+            continue;
+        if (pcolor != NULL &&
+            (ptext == NULL || ptext->first_spec != first + count ||
+             !same_text_color(&ptext->font_color, pcolor)))
+        {
+            XftDrawGlyphFontSpec(prendering->xft_draw, pcolor,
+                                 &prendering->specs[first], count);
+            pcolor = NULL;
+        }
+        if (ptext == NULL)
+            break;
+        if (pcolor == NULL)
+        {
+            pcolor = &ptext->font_color;
+            first = ptext->first_spec;
+            count = 0;
+        }
+        count += ptext->spec_count;
+    }
+}
+
+/* Where the rectangles of a text with the pixel font go */
+typedef struct
+{
+    Rectangle_batch *pbatch;
+    Color color;
+} Pixel_pen;
+
+static void fill_pixels(void *data, int x, int y, int w, int h)
+{
+    Pixel_pen *ppen = (Pixel_pen *)data;
+
+    fill_rectangle(ppen->pbatch, ppen->color, x, y, w, h);
+}
+
+/* Queue the rectangles of either the baked texts with the pixel font or the
+ * others */
+static void draw_pixel_texts(Rectangle_batch *pbatch,
+                             const Display_context *pdc, bool baked)
+{
+    const Text_context *ptext;
+    Pixel_pen pen = {.pbatch = pbatch};
+    int scale = pixel_scale(pdc->geometry);
+    int i;
+
+    for (i = 0; i < pdc->text_rendering.text_count; i++)
+    {
+        ptext = &pdc->text_rendering.ptext[i];
+        if (ptext->renderer != TEXT_PIXEL || ptext->baked != baked ||
+            ptext->string == NULL)
+            continue;
+        pen.color = ptext->rgba;
+        pixel_font_draw(
+            ptext->string, ptext->pos.x + pdc->geometry.x.offset,
+            ptext->pos.y + pdc->geometry.y.offset - ptext->extents.y, scale,
+            fill_pixels, &pen);
+    }
+}
+
+/* Draw the empty bar of a state on the back buffer (within the damaged area
+ * if any) by copying it from the cache, where it is rendered first if need
+ * be */
+static void draw_cached_empty(Display_context *pdc, int state, Colors colors,
+                              const XRectangle *damage, int damage_count)
+{
+    Frame_cache *pcache = &pdc->frame_cache;
+    int width = pdc->geometry.x.offset + pdc->geometry.x.max;
+    int height = pdc->geometry.y.offset + pdc->geometry.y.max;
+    Rectangle_batch batch = {.x = pdc->x,
+                             .palette = pdc->palette,
+                             .palette_size = pdc->palette_size,
+                             .count = 0,
+                             .clip = NULL};
+    int i;
+
+    if (pcache->length != pdc->geometry.length || pcache->width != width ||
+        pcache->height != height ||
+        pcache->x_offset != pdc->geometry.x.offset ||
+        pcache->y_offset != pdc->geometry.y.offset)
+    {
+        print_loge_once("DEBUG: frame cache invalidated\n");
+        invalidate_frame_cache(pdc);
+        pcache->length = pdc->geometry.length;
+        pcache->width = width;
+        pcache->height = height;
+        pcache->x_offset = pdc->geometry.x.offset;
+        pcache->y_offset = pdc->geometry.y.offset;
+    }
+
+    if (pcache->pixmaps[state] == None)
+    {
+        pcache->pixmaps[state] = XCreatePixmap(
+            pdc->x.display, pdc->x.window, width, height, pdc->x.depth);
+        batch.drawable = pcache->pixmaps[state];
+        draw_empty(&batch, pdc->geometry, colors);
+        if (pdc->text_rendering.specs_valid)
+            draw_pixel_texts(&batch, pdc, true);
+        batch_flush(&batch);
+        pdc->x.renderer->flush(pdc->x);
+        if (pdc->text_rendering.specs_valid &&
+            pdc->text_rendering.xft_draw != NULL)
+        {
+            set_text_target(pdc, pcache->pixmaps[state]);
+            draw_glyph_specs(pdc, true);
+        }
+    }
+
+    if (damage == NULL)
+    {
+        XCopyArea(pdc->x.display, pcache->pixmaps[state], pdc->x.back_buffer,
+                  pcache->gc, 0, 0, width, height, 0, 0);
+        return;
+    }
+    for (i = 0; i < damage_count; i++)
+        XCopyArea(pdc->x.display, pcache->pixmaps[state], pdc->x.back_buffer,
+                  pcache->gc, damage[i].x, damage[i].y, damage[i].width,
+                  damage[i].height, damage[i].x, damage[i].y);
+}
+
+/* Draw the texts with a font but the baked ones, within the damaged area if
+ * any */
+static void draw_texts(Display_context *pdc, const XRectangle *damage,
+                       int damage_count)
+{
+    const Text_context *ptext;
+    int i;
+
+    set_text_target(pdc, pdc->x.back_buffer);
+    if (damage != NULL)
+        XftDrawSetClipRectangles(pdc->text_rendering.xft_draw, 0, 0, damage,
+                                 damage_count);
+    if (pdc->text_rendering.specs_valid)
+        draw_glyph_specs(pdc, false);
+    else
+    {
+        /* Out of memory for the glyphs: draw the strings one by one */
+        for (i = 0; i < pdc->text_rendering.text_count; i++)
+        {
+            ptext = &pdc->text_rendering.ptext[i];
+            if (ptext->renderer == TEXT_FONT && ptext->font != NULL)
+                XftDrawStringUtf8(pdc->text_rendering.xft_draw,
+                                  &ptext->font_color, ptext->font,
+                                  ptext->pos.x + pdc->geometry.x.offset,
+                                  ptext->pos.y + pdc->geometry.y.offset,
+                                  (const FcChar8 *)ptext->string,
+                                  strlen(ptext->string));
+        }
+    }
+    if (damage != NULL)
+        XftDrawSetClip(pdc->text_rendering.xft_draw, NULL);
+}
+
+/* Recreate the resources freed by release, timed in debug builds */
+static void rewarm(Display_context *pdc)
+{
+#ifdef DEBUG
+    struct timespec start, end;
+    double duration;
+
+    XSync(pdc->x.display, False);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#endif
+    pdc->x.back_buffer =
+        XdbeAllocateBackBufferName(pdc->x.display, pdc->x.window, 0);
+    pdc->x.backend = pdc->x.renderer->init(pdc->x, pdc->x.visual,
+                                           pdc->x.colormap, pdc->palette,
+                                           pdc->palette_size);
+    if (pdc->x.backend == NULL)
+    {
+        fprintf(stderr, "Error: Cannot initialize the rendering backend\n");
+        exit(EXIT_FAILURE);
+    }
+    if (pdc->idle.xft_draw)
+        pdc->text_rendering.xft_draw = XftDrawCreate(
+            pdc->x.display, pdc->x.back_buffer, pdc->text_rendering.visual,
+            pdc->text_rendering.colormap);
+    pdc->idle.released = false;
+#ifdef DEBUG
+    XSync(pdc->x.display, False);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    duration = elapsed_ms(start, end);
+    pdc->idle.rewarm_ms += duration;
+    print_loge("DEBUG: resources recreated in %.3f ms\n", duration);
+#endif
 }
 
 /* PUBLIC Show a bar filled at value/cap in normal or alternative mode */
-void show(Display_context *pdc, int value, int cap, Overflow_mode overflow_mode,
+bool show(Display_context *pdc, int value, int cap, Overflow_mode overflow_mode,
           Show_mode show_mode, char **words_list)
 {
     print_loge_once("DEBUG: show()\n");
     Colors colors;
     Colors colors_overflow_proportional;
-    static int_fast8_t current_state = 0x0;
-    static int_fast8_t last_state = 0x0;
-
-    int old_length = pdc->geometry.length;
+    Frame_state frame = {.valid = true, .state = 0};
+    XRectangle damage[DAMAGE_MAX];
+    int damage_count = 0;
+    bool full_repaint;
+    bool newly_mapped = false;
+    int i;
+    Rectangle_batch batch = {.x = pdc->x,
+                             .drawable = pdc->x.back_buffer,
+                             .palette = pdc->palette,
+                             .palette_size = pdc->palette_size,
+                             .count = 0,
+                             .clip = NULL};
+#ifdef DEBUG
+    unsigned long first_request = XNextRequest(pdc->x.display);
+#endif
+
+    /* The batch then draws with the recreated backend */
+    if (pdc->idle.released)
+    {
+        rewarm(pdc);
+        batch.x = pdc->x;
+        batch.drawable = pdc->x.back_buffer;
+    }
 
     /* Compute dynamic strings if exists */
-    if (pdc->text_rendering.have_dynamic_strings)
-        compute_dynamic_strings(pdc, words_list);
+    if (pdc->text_rendering.have_dynamic_strings && words_list != NULL &&
+        !compute_dynamic_strings(pdc, words_list, cap))
+        return false;
+
+    pdc->last.value = value;
+    pdc->last.cap = cap;
+    pdc->last.overflow_mode = overflow_mode;
+    pdc->last.show_mode = show_mode;
 
     /* Move the bar for relative positions */
     switch (pdc->geometry.bar_position)
@@ -777,6 +2121,9 @@ void show(Display_context *pdc, int value, int cap, Overflow_mode overflow_mode,
         break;
     case POSITION_COMBINED:
     case POSITION_SPECIFIED:
+        /* The texts may need to be placed again */
+        if (texts_changed(pdc))
+            move_resize_to_monitor(pdc, &pdc->x.monitor_info);
         break;
     }
 
@@ -785,105 +2132,204 @@ void show(Display_context *pdc, int value, int cap, Overflow_mode overflow_mode,
         XMapWindow(pdc->x.display, pdc->x.window);
         XRaiseWindow(pdc->x.display, pdc->x.window);
         pdc->x.mapped = True;
-        current_state ^= STATE_MAPPED;
+        newly_mapped = true;
     }
 
     switch (show_mode)
     {
     case NORMAL:
         colors_overflow_proportional = pdc->colorscheme.normal;
-        current_state &= ~STATE_ALT;
         if (value <= cap)
         {
             colors = pdc->colorscheme.normal;
-            current_state &= ~STATE_OVERFLOW;
         }
         else
         {
             colors = pdc->colorscheme.overflow;
             colors_overflow_proportional.bg = colors.fg;
-            current_state |= STATE_OVERFLOW;
+            frame.state |= STATE_OVERFLOW;
         }
         break;
 
     case ALTERNATIVE:
         colors_overflow_proportional = pdc->colorscheme.alt;
-        current_state |= STATE_ALT;
+        frame.state |= STATE_ALT;
         if (value <= cap)
         {
             colors = pdc->colorscheme.alt;
-            current_state &= ~STATE_OVERFLOW;
         }
         else
         {
             colors = pdc->colorscheme.altoverflow;
             colors_overflow_proportional.bg = colors.fg;
-            current_state |= STATE_OVERFLOW;
+            frame.state |= STATE_OVERFLOW;
         }
         break;
     }
 
-    /* Redraw empty bar only if needed */
-    if (last_state != current_state || old_length != pdc->geometry.length || 1)
+    /* Proportional overflow : draw separator */
+    frame.proportional = value > cap && overflow_mode == PROPORTIONAL &&
+                         cap * pdc->geometry.length / value >
+                             pdc->geometry.padding;
+    frame.filled_length =
+        frame.proportional
+            ? cap * pdc->geometry.length / value
+            : fit_in(value, 0, cap) * pdc->geometry.length / cap;
+    frame.length = pdc->geometry.length;
+    frame.width = pdc->geometry.x.offset + pdc->geometry.x.max;
+    frame.height = pdc->geometry.y.offset + pdc->geometry.y.max;
+    frame.x_offset = pdc->geometry.x.offset;
+    frame.y_offset = pdc->geometry.y.offset;
+
+    /* The back buffer keeps the previous frame: repaint what changed only,
+     * or everything after a change of colors or geometry */
+    full_repaint = !same_layout(pdc->frame, frame) ||
+                   !compute_damage(pdc, frame, damage, &damage_count);
+    if (!full_repaint)
     {
-        /* Empty bar */
-        draw_empty(pdc->x, pdc->geometry, colors);
+        batch.clip = damage;
+        batch.clip_count = damage_count;
     }
-    last_state = current_state;
+    print_loge("DEBUG: %s repaint, %d damaged rectangles\n",
+               full_repaint ? "full" : "partial", damage_count);
 
-    /* Proportional overflow : draw separator */
-    if (value > cap && overflow_mode == PROPORTIONAL &&
-        cap * pdc->geometry.length / value > pdc->geometry.padding)
+    if (full_repaint || damage_count > 0)
     {
-        draw_content(pdc->x, pdc->geometry, cap * pdc->geometry.length / value,
-                     colors_overflow_proportional);
-        draw_separator(pdc->x, pdc->geometry,
-                       cap * pdc->geometry.length / value, colors.bg);
+        /* Before the empty bars, in which static texts are baked */
+        if (pdc->text_rendering.text_count != 0 &&
+            !pdc->text_rendering.specs_valid)
+            build_glyph_specs(pdc);
+
+        /* Empty bar */
+        draw_cached_empty(pdc, frame.state, colors,
+                          full_repaint ? NULL : damage, damage_count);
+
+        if (frame.proportional)
+        {
+            draw_content(&batch, pdc->geometry, frame.filled_length,
+                         colors_overflow_proportional);
+            draw_separator(&batch, pdc->geometry, frame.filled_length,
+                           colors.bg);
+        }
+        else // Value is less then cap
+            /* Content */
+            draw_content(&batch, pdc->geometry, frame.filled_length, colors);
+        draw_pixel_texts(&batch, pdc, false);
+        batch_flush(&batch);
+        pdc->x.renderer->flush(pdc->x);
+
+        /* Draw text */
+        if (pdc->text_rendering.xft_draw != NULL)
+            draw_texts(pdc, full_repaint ? NULL : damage, damage_count);
+        for (i = 0; i < pdc->text_rendering.text_count; i++)
+            pdc->text_rendering.ptext[i].box = text_box(pdc, i);
     }
-    else // Value is less then cap
-        /* Content */
-        draw_content(pdc->x, pdc->geometry,
-                     fit_in(value, 0, cap) * pdc->geometry.length / cap,
-                     colors);
+    pdc->frame = frame;
+    for (i = 0; i < pdc->text_rendering.text_count; i++)
+        pdc->text_rendering.ptext[i].changed = false;
 
+    if (full_repaint || damage_count > 0 || newly_mapped)
+        swap_buffers(pdc);
+    print_loge("DEBUG: %lu requests for the frame\n",
+               XNextRequest(pdc->x.display) - first_request);
     XFlush(pdc->x.display);
+    return true;
+}
 
-    /* Draw text */
-    if (pdc->text_rendering.text_count != 0)
+/* PUBLIC Process the X events received so far for the windows of the given
+ * display contexts and send pending requests */
+void handle_events(X_connection *pconnection, Display_context **pdcs,
+                   int count)
+{
+    XEvent event;
+    bool monitors_changed = false;
+    int base = pconnection->randr_event_base;
+    int i;
+
+    while (XPending(pconnection->display))
     {
-        int i;
-        for (i = 0; i < pdc->text_rendering.text_count; i++)
+        XNextEvent(pconnection->display, &event);
+        if (base != -1 && (event.type == base + RRScreenChangeNotify ||
+                           event.type == base + RRNotify))
         {
-            print_loge("DEBUG: draw_text [%d] [%s]\n", i,
-                       pdc->text_rendering.ptext[i].string);
-            // pdc->text_rendering.xft_draw->drawable = pdc->x.back_buffer;
-            // BUG FIXME without next function in some cases text is not
-            // rendered
-            XftDrawChange(pdc->text_rendering.xft_draw, pdc->x.back_buffer);
-            XftDrawStringUtf8(
-                pdc->text_rendering.xft_draw,
-                &pdc->text_rendering.ptext[i].font_color,
-                pdc->text_rendering.ptext[i].font,
-                pdc->text_rendering.ptext[i].pos.x + pdc->geometry.x.offset,
-                pdc->text_rendering.ptext[i].pos.y + pdc->geometry.y.offset,
-                (const FcChar8 *)pdc->text_rendering.ptext[i].string,
-                strlen(pdc->text_rendering.ptext[i].string));
+            /* Updates the size of the screen */
+            XRRUpdateConfiguration(&event);
+            monitors_changed = true;
+            continue;
         }
 
-        for (i = 0; i < pdc->text_rendering.text_count; i++)
+        switch (event.type)
         {
-            if (pdc->text_rendering.ptext[i].is_dynamic)
+        case PropertyNotify:
+            if (event.xproperty.atom == pconnection->focus.atom)
+                track_active_window(pconnection->display,
+                                    pconnection->screen_number,
+                                    &pconnection->focus);
+            break;
+        case ConfigureNotify:
+            if (event.xconfigure.window != pconnection->focus.window)
+                break;
+            /* Window managers send root coordinates when moving a frame
+             * (ICCCM), real events are relative to the parent */
+            if (event.xconfigure.send_event)
+            {
+                pconnection->focus.x =
+                    event.xconfigure.x + event.xconfigure.width / 2;
+                pconnection->focus.y =
+                    event.xconfigure.y + event.xconfigure.height / 2;
+                pconnection->focus.located = true;
+            }
+            else
+            {
+                pconnection->focus.located = locate_window(
+                    pconnection->display, pconnection->screen_number,
+                    pconnection->focus.window, &pconnection->focus.x,
+                    &pconnection->focus.y);
+            }
+            break;
+        case MapNotify:
+            if (event.xmap.window == pconnection->focus.window)
+                pconnection->focus.located = locate_window(
+                    pconnection->display, pconnection->screen_number,
+                    pconnection->focus.window, &pconnection->focus.x,
+                    &pconnection->focus.y);
+            break;
+        case UnmapNotify:
+            /* Still active (e.g. on another workspace or iconified), located
+             * again once mapped */
+            if (event.xunmap.window == pconnection->focus.window)
+                pconnection->focus.located = false;
+            break;
+        case DestroyNotify:
+            if (event.xdestroywindow.window == pconnection->focus.window)
             {
-                free(pdc->text_rendering.ptext[i].string);
+                pconnection->focus.window = None;
+                pconnection->focus.located = false;
             }
+            break;
+        case Expose:
+            for (i = 0; i < count && pdcs[i]->x.window != event.xany.window;
+                 i++)
+                ;
+            /* The back buffer still holds the last frame */
+            if (i < count && event.xexpose.count == 0 && pdcs[i]->x.mapped)
+                swap_buffers(pdcs[i]);
+            break;
+        default:
+            print_loge("DEBUG: X event %d ignored\n", event.type);
+            break;
         }
     }
 
-    XdbeSwapInfo swap_info;
-    swap_info.swap_window = pdc->x.window;
-    swap_info.swap_action = 0;
-    XdbeSwapBuffers(pdc->x.display, &swap_info, 1);
-    XFlush(pdc->x.display);
+    /* A burst of RandR events is handled once */
+    if (monitors_changed)
+    {
+        update_monitors(pconnection->display, pconnection->screen_number,
+                        &pconnection->monitors);
+        for (i = 0; i < count; i++)
+            follow_monitor(pdcs[i]);
+    }
+    XFlush(pconnection->display);
 }
 
 /* PUBLIC Hide the window */
@@ -896,3 +2342,71 @@ void hide(Display_context *pdc)
         XFlush(pdc->x.display);
     }
 }
+
+/* PUBLIC Free the back buffer, the rendering backend and the frame cache of
+ * a hidden bar. The window, the fonts and the colors of the texts are kept:
+ * they are cheap on the server and slow to get back. */
+void release(Display_context *pdc)
+{
+    if (pdc->x.mapped || pdc->idle.released)
+        return;
+
+    invalidate_frame_cache(pdc);
+    if (pdc->text_rendering.xft_draw != NULL)
+    {
+        XftDrawDestroy(pdc->text_rendering.xft_draw);
+        pdc->text_rendering.xft_draw = NULL;
+    }
+    pdc->x.renderer->destroy(pdc->x);
+    pdc->x.backend = NULL;
+    XdbeDeallocateBackBufferName(pdc->x.display, pdc->x.back_buffer);
+    pdc->x.back_buffer = None;
+
+    /* Nothing of the last frame is left to repaint from */
+    pdc->frame.valid = false;
+    pdc->idle.released = true;
+    pdc->idle.count++;
+    print_loge("DEBUG: resources released (%d times)\n", pdc->idle.count);
+    XFlush(pdc->x.display);
+}
+
+/* PUBLIC Give the texts the fonts loaded in the background and draw the
+ * bars on display again */
+void handle_fonts(X_connection *pconnection, Display_context **pdcs,
+                  int count)
+{
+    Text_context *ptext;
+    bool loaded;
+    int i, j;
+
+    font_loader_finish(&pconnection->fonts, pconnection->display);
+    for (i = 0; i < count; i++)
+    {
+        loaded = false;
+        for (j = 0; j < pdcs[i]->text_rendering.text_count; j++)
+        {
+            ptext = &pdcs[i]->text_rendering.ptext[j];
+            if (ptext->font != NULL || ptext->font_request == -1)
+                continue;
+            ptext->font = font_loader_get(&pconnection->fonts,
+                                          pconnection->display,
+                                          ptext->font_request);
+            if (ptext->font == NULL)
+                continue;
+            /* Placed again on the next show like a dynamic text */
+            if (ptext->string != NULL)
+                measure_text(pdcs[i], ptext);
+            ptext->changed = true;
+            loaded = true;
+        }
+        if (!loaded)
+            continue;
+
+        /* Static texts may be baked in the empty bars */
+        pdcs[i]->text_rendering.specs_valid = false;
+        invalidate_frame_cache(pdcs[i]);
+        if (pdcs[i]->x.mapped)
+            show(pdcs[i], pdcs[i]->last.value, pdcs[i]->last.cap,
+                 pdcs[i]->last.overflow_mode, pdcs[i]->last.show_mode, NULL);
+    }
+}
@@ -19,16 +19,29 @@
 #define DISPLAY_H
 
 #include "conf.h"
+#include "fonts.h"
+#include "layout.h"
 #include "parser.h"
 #include <X11/Xft/Xft.h>
 #include <X11/Xlib.h>
 #include <X11/extensions/Xdbe.h>
 #include <X11/extensions/Xrandr.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 #define STATE_ALT (0x1)
 #define STATE_OVERFLOW (0x1 << 1)
-#define STATE_MAPPED (0x1 << 2)
+#define STATE_COUNT 4
+
+/* Colors of the texts drawn with the pixel font, besides the colorscheme */
+#define PIXEL_COLORS_MAX 4
+
+/* Transparent, the colors of a colorscheme and those of the pixel font */
+#define PALETTE_SIZE (13 + PIXEL_COLORS_MAX)
+
+/* Rectangles repainted at most for an update, beyond which the whole frame is
+ * repainted */
+#define DAMAGE_MAX 8
 
 typedef enum
 {
@@ -46,19 +59,33 @@ typedef enum
 
 typedef struct
 {
-    char name[10];
+    char name[LNAME_MONITOR];
     int x;
     int y;
     int width;
     int height;
 } MonitorInfo;
 
+/* Monitors of the screen, queried again only when RandR reports a change */
 typedef struct
 {
-    XftColor font_color;
-    XftFont *font;
+    MonitorInfo *monitors;
+    int count;
+} Monitor_list;
+
+typedef struct
+{
+    Text_renderer renderer;
+    Color rgba;          /* Color of the pixel font */
+    XftColor font_color; /* Color and font of the others */
+    XftFont *font;       /* NULL until loaded */
+    int font_request;    /* In the font loader of the connection */
     char *string;
+    int string_size;   /* Of the buffer, 0 for static strings */
+    char *next_string; /* Buffer swapped with string when it changes */
+    int next_size;
     bool is_dynamic;
+    bool changed; /* Dynamic string different from the one on display */
     Dynamic_string *pdyn_str;
     struct
     {
@@ -67,6 +94,11 @@ typedef struct
     } pos;
     int width;
     int height;
+    XGlyphInfo extents;
+    XRectangle box; /* Where the text has last been drawn */
+    int first_spec; /* Glyphs of the text in the glyph specs */
+    int spec_count;
+    bool baked; /* Static text drawn in the frame cache */
     Dim x;
     Dim y;
     Align_pos align;
@@ -78,22 +110,107 @@ typedef struct
     int text_count;
     bool have_dynamic_strings;
 
-    XftDraw *xft_draw;
+    /* Positioned glyphs of all the texts, resolved again only when a string
+     * or a position changes */
+    XftGlyphFontSpec *specs;
+    int spec_count;
+    int spec_size;
+    bool specs_valid;
+
+    XftDraw *xft_draw; /* NULL if all the texts use the pixel font */
     Colormap colormap;
     Visual *visual;
 } Text_rendering_context;
 
+/* Rendering backend (see below) and its resources, defined by
+ * display_xlib.c, display_xrender.c and display_shm.c */
+typedef struct Renderer Renderer;
+typedef struct Backend_context Backend_context;
+
+/* Center of the active window, followed through the _NET_ACTIVE_WINDOW
+ * property of EWMH window managers so that showing a bar relative to the
+ * focus takes no round trip */
+typedef struct
+{
+    bool enabled;
+    bool ewmh; /* Otherwise the focus is queried on each show */
+    Atom atom;
+    Window window; /* None if there is no active window */
+    bool located;
+    int x;
+    int y;
+} Focus_tracker;
+
+/* Resources shared by all the bars on a display */
+typedef struct
+{
+    Display *display;
+    int screen_number;
+    Screen *screen;
+    const Renderer *renderer;
+    Depth depth;
+    Colormap colormap;
+    int randr_event_base;
+    Monitor_list monitors;
+    Focus_tracker focus;
+    Layout_cache *layouts;
+    Font_loader fonts;
+} X_connection;
+
 typedef struct
 {
     Display *display;
     int screen_number;
     Screen *screen;
     Window window;
+    XRectangle area; /* Position and size of the window */
     Bool mapped;
     MonitorInfo monitor_info;
+    const Monitor_list *monitors; /* Shared with the connection */
+    const Focus_tracker *focus;
+    Layout_cache *layouts;
     XdbeBackBuffer back_buffer;
+    int depth;
+    Visual *visual;
+    Colormap colormap;
+    const Renderer *renderer;
+    Backend_context *backend;
 } X_context;
 
+struct Renderer
+{
+    const char *name;
+
+    /* Whether the backend can draw on a display */
+    bool (*available)(Display *display, int screen_number);
+
+    /* Depth and visual of the windows (with an alpha channel if supported) */
+    Depth (*get_display_depth)(Display *display, int screen_number);
+
+    /* Prepare the backend to draw on the back buffer with the colors of a
+     * palette. Returns NULL on failure. */
+    Backend_context *(*init)(X_context xc, Visual *visual, Colormap colormap,
+                             const Color *palette, int palette_size);
+    void (*destroy)(X_context xc);
+
+    /* Draw rectangles with a color of the palette on the back buffer or on a
+     * pixmap of the same depth */
+    void (*fill_rectangles)(X_context xc, Drawable drawable, int color,
+                            XRectangle *rectangles, int count);
+
+    /* Make sure the rectangles drawn so far reach the server before other
+     * requests (e.g. drawing text, copying areas or swapping buffers) */
+    void (*flush)(X_context xc);
+};
+
+extern const Renderer renderer_xlib;
+#ifdef WITH_XRENDER
+extern const Renderer renderer_xrender;
+#endif
+#ifdef WITH_SHM
+extern const Renderer renderer_shm;
+#endif
+
 typedef struct
 {
     int outline;
@@ -127,24 +244,93 @@ typedef struct
     int fat_layer;
 } Geometry_context;
 
+/* What the back buffer holds, so that only the changes are repainted */
+typedef struct
+{
+    bool valid;
+    int state; /* STATE_ALT and STATE_OVERFLOW */
+    bool proportional;
+    int filled_length;
+    int length;
+    int width;
+    int height;
+    int x_offset;
+    int y_offset;
+} Frame_state;
+
+/* Empty bars (transparent background, outline, border and padding) with the
+ * static texts off the content rendered once per state for a given
+ * geometry */
+typedef struct
+{
+    Pixmap pixmaps[STATE_COUNT]; /* None until needed */
+    GC gc;
+    int length;
+    int width;
+    int height;
+    int x_offset;
+    int y_offset;
+} Frame_cache;
+
 typedef struct
 {
     X_context x;
+    Frame_state frame;
+    Frame_cache frame_cache;
     Colorscheme colorscheme;
+    Color palette[PALETTE_SIZE]; /* Distinct colors of the colorscheme */
+    int palette_size;
     Geometry_context geometry;
     Text_rendering_context text_rendering;
+
+    /* Last value shown, drawn again when a font is loaded */
+    struct
+    {
+        int value;
+        int cap;
+        Overflow_mode overflow_mode;
+        Show_mode show_mode;
+    } last;
+
+    /* Back buffer, rendering backend and frame cache freed after a long
+     * hidden period, and what recreating them on the next show cost (in
+     * debug builds) */
+    struct
+    {
+        bool released;
+        bool xft_draw; /* Whether to create the XftDraw again */
+        int count;
+        double rewarm_ms;
+    } idle;
 } Display_context;
 
-Display_context init(Style conf);
-void show(Display_context *pdc, int value, int cap, Overflow_mode overflow_mode,
+/* The renderer is the fastest available one if renderer_name is "auto" */
+X_connection connect_display(const char *renderer_name);
+void disconnect_display(X_connection *pconnection);
+Display_context init(X_connection *pconnection, Style conf);
+
+/* The dynamic texts are kept as they are if words_list is NULL. Returns
+ * false, with nothing drawn, if words_list has fewer words than they need. */
+bool show(Display_context *pdc, int value, int cap, Overflow_mode overflow_mode,
           Show_mode show_mode, char **words_list);
 void hide(Display_context *pdc);
+
+/* Free the server-side resources of a hidden bar until it is shown again */
+void release(Display_context *pdc);
+void handle_events(X_connection *pconnection, Display_context **pdcs,
+                   int count);
+
+/* Give the texts the fonts loaded in the background once the file
+ * descriptor of the font loader is readable, and draw the bars on display
+ * again */
+void handle_fonts(X_connection *pconnection, Display_context **pdcs,
+                  int count);
 void display_context_destroy(Display_context *pdc);
 
-/* Draw a rectangle with the given size, position and color */
-void fill_rectangle(X_context xc, Color c, int x, int y, unsigned int w,
-                    unsigned int h);
+/* Returns the renderer of a given name, or NULL if it is not built in */
+const Renderer *find_renderer(const char *name);
 
-Depth get_display_context_depth(Display_context dc);
+/* Print the names of the renderers built in, separated by spaces */
+void print_renderers(FILE *stream);
 
 #endif /* __DISPLAY_H__ */
@@ -0,0 +1,458 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Software rendering backend: rectangles are rasterized into an image in
+ * shared memory and only the drawn rectangles are uploaded with
+ * XShmPutImage. Requires a local X server. */
+
+#define _XOPEN_SOURCE 500
+#include "display.h"
+#include "log.h"
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* Rectangles drawn but not uploaded yet */
+#define PENDING_MAX 32
+
+/* Disjoint rectangles covering the pending ones: at most one band per pair of
+ * edges, with one span per rectangle */
+#define UPLOADS_MAX (2 * PENDING_MAX * PENDING_MAX)
+
+struct Backend_context
+{
+    XShmSegmentInfo segment;
+    XImage *image; /* NULL until something is drawn */
+    Visual *visual;
+    GC gc;
+    uint32_t pixels[PALETTE_SIZE];
+    Drawable drawable; /* Of all the pending rectangles */
+    XRectangle pending[PENDING_MAX];
+    int pending_count;
+    bool uploading;         /* The server may still be reading the image */
+    unsigned long last_put; /* Serial of the last upload */
+};
+
+static void backend_flush(X_context xc);
+
+/* Scale an 8-bit channel to the bits of a mask */
+static uint32_t channel_to_mask(unsigned int value, unsigned long mask)
+{
+    int shift = 0;
+    int bits = 0;
+
+    if (mask == 0)
+        return 0;
+    while (!((mask >> shift) & 1))
+        shift++;
+    while ((mask >> (shift + bits)) & 1)
+        bits++;
+    return (uint32_t)((bits < 8 ? value >> (8 - bits) : value) << shift);
+}
+
+/* Pixel value of a color, premultiplied by its alpha on 32-bit visuals as
+ * XRender expects */
+static uint32_t pixel_from_color(Visual *visual, int depth, Color color)
+{
+    unsigned int alpha = depth == 32 ? color.alpha : 0xff;
+    unsigned long alpha_mask =
+        depth == 32 ? 0xffffffffUL & ~(visual->red_mask | visual->green_mask |
+                                       visual->blue_mask)
+                    : 0;
+
+    return channel_to_mask(color.red * alpha / 0xff, visual->red_mask) |
+           channel_to_mask(color.green * alpha / 0xff, visual->green_mask) |
+           channel_to_mask(color.blue * alpha / 0xff, visual->blue_mask) |
+           channel_to_mask(alpha, alpha_mask);
+}
+
+/* Fill a row of pixels, using the widest vector instructions the build
+ * targets */
+static void fill_row(uint32_t *row, int count, uint32_t pixel)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i pixels8 = _mm256_set1_epi32((int)pixel);
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256((__m256i *)(row + i), pixels8);
+#endif
+#if defined(__SSE2__)
+    __m128i pixels4 = _mm_set1_epi32((int)pixel);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i *)(row + i), pixels4);
+#endif
+    for (; i < count; i++)
+        row[i] = pixel;
+}
+
+/* Wait until the server has read the last uploads before writing to the
+ * image. The completion events processed by the main loop usually make this
+ * free. */
+static void wait_uploads(X_context xc)
+{
+    if (xc.backend->uploading &&
+        (long)(xc.backend->last_put - LastKnownRequestProcessed(xc.display)) >
+            0)
+    {
+        print_loge_once("DEBUG: waiting for the SHM uploads\n");
+        XSync(xc.display, False);
+    }
+    xc.backend->uploading = false;
+}
+
+static void free_image(X_context xc)
+{
+    if (xc.backend->image == NULL)
+        return;
+    XShmDetach(xc.display, &xc.backend->segment);
+    xc.backend->image->data = NULL;
+    XDestroyImage(xc.backend->image);
+    shmdt(xc.backend->segment.shmaddr);
+    xc.backend->image = NULL;
+}
+
+/* Make sure the image covers a rectangle. Returns false on failure. */
+static bool fit_image(X_context xc, const XRectangle *prectangle)
+{
+    Backend_context *pbackend = xc.backend;
+    unsigned int width = prectangle->x + prectangle->width;
+    unsigned int height = prectangle->y + prectangle->height;
+
+    if (pbackend->image != NULL &&
+        width <= (unsigned int)pbackend->image->width &&
+        height <= (unsigned int)pbackend->image->height)
+        return true;
+
+    if (pbackend->image != NULL)
+    {
+        /* Upload what has been drawn in the old image first */
+        backend_flush(xc);
+        wait_uploads(xc);
+        width = width > (unsigned int)pbackend->image->width
+                    ? width
+                    : (unsigned int)pbackend->image->width;
+        height = height > (unsigned int)pbackend->image->height
+                     ? height
+                     : (unsigned int)pbackend->image->height;
+        free_image(xc);
+    }
+
+    pbackend->image =
+        XShmCreateImage(xc.display, pbackend->visual, xc.depth, ZPixmap, NULL,
+                        &pbackend->segment, width, height);
+    if (pbackend->image == NULL)
+        return false;
+    if (pbackend->image->bits_per_pixel != 32)
+    {
+        fprintf(stderr, "Error: SHM rendering needs 32-bit pixels\n");
+        XDestroyImage(pbackend->image);
+        pbackend->image = NULL;
+        return false;
+    }
+
+    pbackend->segment.shmid =
+        shmget(IPC_PRIVATE, pbackend->image->bytes_per_line * height,
+               IPC_CREAT | 0600);
+    pbackend->segment.shmaddr = pbackend->image->data =
+        shmat(pbackend->segment.shmid, NULL, 0);
+    pbackend->segment.readOnly = True;
+    if (pbackend->segment.shmid == -1 ||
+        pbackend->segment.shmaddr == (char *)-1 ||
+        !XShmAttach(xc.display, &pbackend->segment))
+    {
+        fprintf(stderr, "Error: Cannot share an image with the X server\n");
+        if (pbackend->segment.shmid != -1)
+            shmctl(pbackend->segment.shmid, IPC_RMID, NULL);
+        pbackend->image->data = NULL;
+        XDestroyImage(pbackend->image);
+        pbackend->image = NULL;
+        return false;
+    }
+
+    /* The segment is removed once both sides are attached */
+    XSync(xc.display, False);
+    shmctl(pbackend->segment.shmid, IPC_RMID, NULL);
+    print_loge("DEBUG: SHM image of %ux%u\n", width, height);
+    return true;
+}
+
+static Backend_context *backend_init(X_context xc, Visual *visual,
+                                     Colormap colormap, const Color *palette,
+                                     int palette_size)
+{
+    int i;
+    Backend_context *pbackend;
+
+    (void)colormap;
+    pbackend = (Backend_context *)malloc(sizeof(Backend_context));
+    if (pbackend == NULL)
+        return NULL;
+
+    for (i = 0; i < palette_size; i++)
+        pbackend->pixels[i] = pixel_from_color(visual, xc.depth, palette[i]);
+    pbackend->image = NULL;
+    pbackend->visual = visual;
+    pbackend->gc = XCreateGC(xc.display, xc.back_buffer, 0, NULL);
+    pbackend->pending_count = 0;
+    pbackend->uploading = false;
+    return pbackend;
+}
+
+static void backend_destroy(X_context xc)
+{
+    wait_uploads(xc);
+    free_image(xc);
+    XFreeGC(xc.display, xc.backend->gc);
+    free(xc.backend);
+}
+
+static void fill_rectangles(X_context xc, Drawable drawable, int color,
+                            XRectangle *rectangles, int count)
+{
+    Backend_context *pbackend = xc.backend;
+    char *row;
+    int i, y;
+
+    wait_uploads(xc);
+    if (pbackend->pending_count > 0 && pbackend->drawable != drawable)
+    {
+        backend_flush(xc);
+        wait_uploads(xc);
+    }
+    pbackend->drawable = drawable;
+    for (i = 0; i < count; i++)
+    {
+        if (pbackend->pending_count == PENDING_MAX)
+        {
+            backend_flush(xc);
+            wait_uploads(xc);
+        }
+        if (!fit_image(xc, &rectangles[i]))
+            continue;
+
+        row = pbackend->image->data +
+              rectangles[i].y * pbackend->image->bytes_per_line +
+              rectangles[i].x * sizeof(uint32_t);
+        for (y = 0; y < rectangles[i].height; y++)
+        {
+            fill_row((uint32_t *)row, rectangles[i].width,
+                     pbackend->pixels[color]);
+            row += pbackend->image->bytes_per_line;
+        }
+
+        pbackend->pending[pbackend->pending_count++] = rectangles[i];
+    }
+}
+
+/* Sort values in place, there are a few dozens at most */
+static void sort_ints(int *values, int count)
+{
+    int i, j, value;
+
+    for (i = 1; i < count; i++)
+    {
+        value = values[i];
+        for (j = i; j > 0 && values[j - 1] > value; j--)
+            values[j] = values[j - 1];
+        values[j] = value;
+    }
+}
+
+/* Split the union of rectangles into bands of rows holding disjoint spans,
+ * so that every pixel is uploaded once. The pixels of the image between the
+ * rectangles are stale (the drawable has texts or copies there), hence no
+ * bounding box. Consecutive bands with the same spans are merged: a whole
+ * frame is a single rectangle. Returns the number of rectangles. */
+static int union_rectangles(const XRectangle *rectangles, int count,
+                            XRectangle *uploads)
+{
+    int edges[2 * PENDING_MAX];
+    int starts[PENDING_MAX];
+    int ends[PENDING_MAX];
+    int edge_count = 0;
+    int upload_count = 0;
+    int band_start = 0; /* First rectangle of the previous band */
+    int band_count = 0;
+    int band, span_count, i, j;
+    bool same;
+
+    for (i = 0; i < count; i++)
+    {
+        edges[edge_count++] = rectangles[i].y;
+        edges[edge_count++] = rectangles[i].y + rectangles[i].height;
+    }
+    sort_ints(edges, edge_count);
+
+    for (band = 0; band + 1 < edge_count; band++)
+    {
+        if (edges[band] == edges[band + 1])
+            continue;
+
+        /* Spans of the rectangles covering the band, merged */
+        span_count = 0;
+        for (i = 0; i < count; i++)
+        {
+            if (rectangles[i].y <= edges[band] &&
+                rectangles[i].y + rectangles[i].height >= edges[band + 1])
+            {
+                starts[span_count] = rectangles[i].x;
+                ends[span_count++] = rectangles[i].x + rectangles[i].width;
+            }
+        }
+        sort_ints(starts, span_count);
+        sort_ints(ends, span_count);
+        for (i = 0, j = 0; i < span_count; i++)
+        {
+            if (j > 0 && starts[i] <= ends[j - 1])
+            {
+                ends[j - 1] = ends[i];
+                continue;
+            }
+            starts[j] = starts[i];
+            ends[j++] = ends[i];
+        }
+        span_count = j;
+
+        /* Extend the previous band if it is right above with the same
+         * spans */
+        same = band_count == span_count && band_count > 0 &&
+               uploads[band_start].y + uploads[band_start].height ==
+                   edges[band];
+        for (i = 0; same && i < span_count; i++)
+            same = uploads[band_start + i].x == starts[i] &&
+                   uploads[band_start + i].x + uploads[band_start + i].width ==
+                       ends[i];
+        if (same)
+        {
+            for (i = 0; i < span_count; i++)
+                uploads[band_start + i].height += edges[band + 1] -
+                                                  edges[band];
+            continue;
+        }
+
+        band_start = upload_count;
+        band_count = span_count;
+        for (i = 0; i < span_count; i++)
+        {
+            uploads[upload_count++] =
+                (XRectangle){.x = starts[i],
+                             .y = edges[band],
+                             .width = ends[i] - starts[i],
+                             .height = edges[band + 1] - edges[band]};
+        }
+    }
+    return upload_count;
+}
+
+static void backend_flush(X_context xc)
+{
+    Backend_context *pbackend = xc.backend;
+    XRectangle uploads[UPLOADS_MAX];
+    int upload_count;
+    int i;
+
+    if (pbackend->pending_count == 0)
+        return;
+
+    upload_count = union_rectangles(pbackend->pending,
+                                    pbackend->pending_count, uploads);
+    print_loge("DEBUG: %d SHM rectangles uploaded as %d\n",
+               pbackend->pending_count, upload_count);
+    for (i = 0; i < upload_count; i++)
+    {
+        XShmPutImage(xc.display, pbackend->drawable, pbackend->gc,
+                     pbackend->image, uploads[i].x, uploads[i].y, uploads[i].x,
+                     uploads[i].y, uploads[i].width, uploads[i].height,
+                     i == upload_count - 1);
+    }
+    pbackend->last_put = NextRequest(xc.display) - 1;
+    pbackend->uploading = true;
+    pbackend->pending_count = 0;
+}
+
+static Depth get_display_depth(Display *display, int screen_number)
+{
+    XVisualInfo info;
+
+    /* An ARGB visual lets a compositor blend the transparent pixels */
+    if (XMatchVisualInfo(display, screen_number, 32, TrueColor, &info))
+        return (Depth){.depth = 32, .visuals = info.visual, .nvisuals = 1};
+    return (Depth){.depth = DefaultDepth(display, screen_number),
+                   .visuals = DefaultVisual(display, screen_number),
+                   .nvisuals = 1};
+}
+
+static bool attach_failed;
+
+static int handle_attach_error(Display *display, XErrorEvent *error)
+{
+    (void)display;
+    (void)error;
+    attach_failed = true;
+    return 0;
+}
+
+/* Shared memory only works with a local X server, which the extension being
+ * listed does not guarantee (e.g. through SSH): try to attach a segment */
+static bool available(Display *display, int screen_number)
+{
+    XShmSegmentInfo segment;
+    int (*previous_handler)(Display *, XErrorEvent *);
+
+    (void)screen_number;
+    if (!XShmQueryExtension(display))
+        return false;
+
+    segment.shmid = shmget(IPC_PRIVATE, 4096, IPC_CREAT | 0600);
+    if (segment.shmid == -1)
+        return false;
+    segment.shmaddr = shmat(segment.shmid, NULL, 0);
+    segment.readOnly = True;
+    attach_failed = segment.shmaddr == (char *)-1;
+    if (!attach_failed)
+    {
+        XSync(display, False);
+        previous_handler = XSetErrorHandler(handle_attach_error);
+        attach_failed = !XShmAttach(display, &segment);
+        XSync(display, False);
+        if (!attach_failed)
+            XShmDetach(display, &segment);
+        XSync(display, False);
+        XSetErrorHandler(previous_handler);
+        shmdt(segment.shmaddr);
+    }
+    shmctl(segment.shmid, IPC_RMID, NULL);
+    return !attach_failed;
+}
+
+const Renderer renderer_shm = {.name = "shm",
+                               .available = available,
+                               .get_display_depth = get_display_depth,
+                               .init = backend_init,
+                               .destroy = backend_destroy,
+                               .fill_rectangles = fill_rectangles,
+                               .flush = backend_flush};
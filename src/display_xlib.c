@@ -17,34 +17,105 @@
 
 #include "display.h"
 #include <X11/Xlib.h>
+#include <stdio.h>
+#include <stdlib.h>
 
-static GC gc_from_color(X_context xc, Color color)
+/* Pixels allocated once for the colors of the palette and a single GC whose
+ * foreground changes between batches, so that drawing takes no round trip */
+struct Backend_context
 {
-    XColor xcolor = {
-        .red = color.red * 257,
-        .green = color.green * 257,
-        .blue = color.blue * 257,
-        .flags = DoRed | DoGreen | DoBlue,
-    };
-    GC gc = XCreateGC(xc.display, xc.window, 0, NULL);
-    Colormap colormap = DefaultColormap(xc.display, xc.screen_number);
-    XAllocColor(xc.display, colormap, &xcolor);
-    XSetForeground(xc.display, gc, xcolor.pixel);
-    return gc;
+    GC gc;
+    Colormap colormap;
+    unsigned long pixels[PALETTE_SIZE];
+    unsigned long allocated[PALETTE_SIZE]; /* Pixels to free */
+    int allocated_count;
+    int foreground; /* Index of the current foreground in the palette */
+};
+
+static Backend_context *backend_init(X_context xc, Visual *visual,
+                                     Colormap colormap, const Color *palette,
+                                     int palette_size)
+{
+    int i;
+    XColor xcolor;
+    Backend_context *pbackend =
+        (Backend_context *)malloc(sizeof(Backend_context));
+
+    (void)visual;
+    if (pbackend == NULL)
+        return NULL;
+
+    pbackend->colormap = colormap;
+    pbackend->allocated_count = 0;
+    for (i = 0; i < palette_size; i++)
+    {
+        xcolor = (XColor){
+            .red = palette[i].red * 257,
+            .green = palette[i].green * 257,
+            .blue = palette[i].blue * 257,
+            .flags = DoRed | DoGreen | DoBlue,
+        };
+        if (XAllocColor(xc.display, colormap, &xcolor))
+        {
+            pbackend->allocated[pbackend->allocated_count++] = xcolor.pixel;
+        }
+        else
+        {
+            fprintf(stderr, "Error: cannot allocate color #%02x%02x%02x\n",
+                    palette[i].red, palette[i].green, palette[i].blue);
+            xcolor.pixel = BlackPixel(xc.display, xc.screen_number);
+        }
+        pbackend->pixels[i] = xcolor.pixel;
+    }
+
+    pbackend->gc = XCreateGC(xc.display, xc.back_buffer, 0, NULL);
+    pbackend->foreground = -1;
+    return pbackend;
+}
+
+static void backend_destroy(X_context xc)
+{
+    XFreeColors(xc.display, xc.backend->colormap, xc.backend->allocated,
+                xc.backend->allocated_count, 0);
+    XFreeGC(xc.display, xc.backend->gc);
+    free(xc.backend);
 }
 
-void fill_rectangle(X_context xc, Color color, int x, int y, unsigned int w,
-                    unsigned int h)
+static void fill_rectangles(X_context xc, Drawable drawable, int color,
+                            XRectangle *rectangles, int count)
 {
-    GC xgc = gc_from_color(xc, color);
-    // XFillRectangle(xc.display, xc.window, xgc, x, y, w, h);
-    XFillRectangle(xc.display, xc.back_buffer, xgc, x, y, w, h);
-    XFreeGC(xc.display, xgc);
+    if (xc.backend->foreground != color)
+    {
+        XSetForeground(xc.display, xc.backend->gc, xc.backend->pixels[color]);
+        xc.backend->foreground = color;
+    }
+    XFillRectangles(xc.display, drawable, xc.backend->gc, rectangles, count);
 }
 
-Depth get_display_context_depth(Display_context dc)
+static void backend_flush(X_context xc)
 {
-    return (Depth){.depth = DefaultDepth(dc.x.display, dc.x.screen_number),
-                   .visuals = DefaultVisual(dc.x.display, dc.x.screen_number),
+    (void)xc;
+}
+
+static Depth get_display_depth(Display *display, int screen_number)
+{
+    return (Depth){.depth = DefaultDepth(display, screen_number),
+                   .visuals = DefaultVisual(display, screen_number),
                    .nvisuals = 1};
 }
+
+/* Core requests work on any display */
+static bool available(Display *display, int screen_number)
+{
+    (void)display;
+    (void)screen_number;
+    return true;
+}
+
+const Renderer renderer_xlib = {.name = "xlib",
+                                .available = available,
+                                .get_display_depth = get_display_depth,
+                                .init = backend_init,
+                                .destroy = backend_destroy,
+                                .fill_rectangles = fill_rectangles,
+                                .flush = backend_flush};
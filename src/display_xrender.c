@@ -20,20 +20,20 @@
 #include <X11/extensions/Xrender.h>
 #include <stdlib.h>
 
-static Bool is_alpha_visual(Display_context dc, Visual *visual)
+static Bool is_alpha_visual(Display *display, Visual *visual)
 {
-    XRenderPictFormat *fmt = XRenderFindVisualFormat(dc.x.display, visual);
+    XRenderPictFormat *fmt = XRenderFindVisualFormat(display, visual);
     return (fmt->type == PictTypeDirect && fmt->direct.alphaMask);
 }
 
-static Depth get_alpha_depth_if_available(Display_context dc)
+static Depth get_alpha_depth_if_available(Display *display, int screen_number)
 {
     Depth depth;
     depth.nvisuals = 0;
 
     int depths_list_num;
     int *depths_list =
-        XListDepths(dc.x.display, dc.x.screen_number, &depths_list_num);
+        XListDepths(display, screen_number, &depths_list_num);
 
     for (int i = depths_list_num - 1; i != 0; i--)
     {
@@ -45,15 +45,15 @@ static Depth get_alpha_depth_if_available(Display_context dc)
             static long visual_template_mask =
                 VisualScreenMask | VisualDepthMask | VisualClassMask;
             XVisualInfo visual_template = {
-                .screen = dc.x.screen_number, .depth = 32, .class = TrueColor};
+                .screen = screen_number, .depth = 32, .class = TrueColor};
 
             visuals_available =
-                XGetVisualInfo(dc.x.display, visual_template_mask,
+                XGetVisualInfo(display, visual_template_mask,
                                &visual_template, &visuals_count);
 
             for (int i = 0; i < visuals_count; i++)
             {
-                if (is_alpha_visual(dc, visuals_available[i].visual))
+                if (is_alpha_visual(display, visuals_available[i].visual))
                 {
                     depth.visuals = visuals_available[i].visual;
                     depth.nvisuals = 1;
@@ -78,26 +78,87 @@ static XRenderColor xrendercolor_from_color(Color color)
                           .blue = (color.blue * 257 * alpha) / 0xffffU};
 }
 
-void fill_rectangle(X_context xc, Color c, int x, int y, unsigned int w,
-                    unsigned int h)
+/* Picture of the back buffer and premultiplied colors, so that drawing
+ * takes no round trip */
+struct Backend_context
 {
-    XRenderColor xrc = xrendercolor_from_color(c);
-    XWindowAttributes attrib;
-    XGetWindowAttributes(xc.display, xc.window, &attrib);
-    XRenderPictFormat *pfmt =
-        XRenderFindVisualFormat(xc.display, attrib.visual);
-
-    // Picture pict = XRenderCreatePicture(xc.display, xc.window, pfmt, 0, 0);
-    Picture pict = XRenderCreatePicture(xc.display, xc.back_buffer, pfmt, 0, 0);
-    XRenderFillRectangle(xc.display, PictOpSrc, pict, &xrc, x, y, w, h);
-    XRenderFreePicture(xc.display, pict);
+    XRenderPictFormat *format;
+    Picture picture;
+    XRenderColor colors[PALETTE_SIZE];
+};
+
+static Backend_context *backend_init(X_context xc, Visual *visual,
+                                     Colormap colormap, const Color *palette,
+                                     int palette_size)
+{
+    int i;
+    Backend_context *pbackend =
+        (Backend_context *)malloc(sizeof(Backend_context));
+
+    (void)colormap;
+    if (pbackend == NULL)
+        return NULL;
+
+    pbackend->format = XRenderFindVisualFormat(xc.display, visual);
+    pbackend->picture = XRenderCreatePicture(xc.display, xc.back_buffer,
+                                             pbackend->format, 0, NULL);
+    for (i = 0; i < palette_size; i++)
+        pbackend->colors[i] = xrendercolor_from_color(palette[i]);
+    return pbackend;
+}
+
+static void backend_destroy(X_context xc)
+{
+    XRenderFreePicture(xc.display, xc.backend->picture);
+    free(xc.backend);
+}
+
+static void fill_rectangles(X_context xc, Drawable drawable, int color,
+                            XRectangle *rectangles, int count)
+{
+    Picture picture;
+
+    if (drawable == xc.back_buffer)
+    {
+        XRenderFillRectangles(xc.display, PictOpSrc, xc.backend->picture,
+                              &xc.backend->colors[color], rectangles, count);
+        return;
+    }
+
+    /* Pixmaps are rarely drawn on, once for all */
+    picture =
+        XRenderCreatePicture(xc.display, drawable, xc.backend->format, 0, NULL);
+    XRenderFillRectangles(xc.display, PictOpSrc, picture,
+                          &xc.backend->colors[color], rectangles, count);
+    XRenderFreePicture(xc.display, picture);
+}
+
+static void backend_flush(X_context xc)
+{
+    (void)xc;
 }
 
-Depth get_display_context_depth(Display_context dc)
+static Depth get_display_depth(Display *display, int screen_number)
 {
-    Depth depth = {.depth = DefaultDepth(dc.x.display, dc.x.screen_number),
-                   .visuals = DefaultVisual(dc.x.display, dc.x.screen_number),
+    Depth depth = {.depth = DefaultDepth(display, screen_number),
+                   .visuals = DefaultVisual(display, screen_number),
                    .nvisuals = 1};
-    Depth adepth = get_alpha_depth_if_available(dc);
+    Depth adepth = get_alpha_depth_if_available(display, screen_number);
     return adepth.nvisuals == 1 ? adepth : depth;
 }
+
+static bool available(Display *display, int screen_number)
+{
+    int event_base, error_base;
+
+    (void)screen_number;
+    return XRenderQueryExtension(display, &event_base, &error_base);
+}
+
+const Renderer renderer_xrender = {.name = "xrender",
+                                   .available = available,
+                                   .get_display_depth = get_display_depth,
+                                   .init = backend_init,
+                                   .destroy = backend_destroy,
+                                   .fill_rectangles = fill_rectangles,
+                                   .flush = backend_flush};
@@ -0,0 +1,202 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _XOPEN_SOURCE 500
+#include "fonts.h"
+#include "log.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Fontconfig part of XftFontMatch, which is thread safe */
+static void match_request(Font_request *prequest)
+{
+    FcResult result;
+    FcPattern *match;
+
+    FcConfigSubstitute(NULL, prequest->pattern, FcMatchPattern);
+    match = FcFontMatch(NULL, prequest->pattern, &result);
+    FcPatternDestroy(prequest->pattern);
+    prequest->pattern = match;
+    prequest->matched = true;
+}
+
+/* Like XftFontOpenName once the pattern is matched */
+static void open_request(Font_request *prequest, Display *display)
+{
+    if (prequest->pattern != NULL)
+    {
+        prequest->font = XftFontOpenPattern(display, prequest->pattern);
+        if (prequest->font == NULL)
+            FcPatternDestroy(prequest->pattern);
+        prequest->pattern = NULL;
+    }
+    if (prequest->font != NULL)
+        fprintf(stderr, "Info: Loaded font \"%s\"\n", prequest->name);
+    else
+        fprintf(stderr, "Error: Font \"%s\" is not loaded\n", prequest->name);
+}
+
+static void *match_requests(void *data)
+{
+    Font_loader *ploader = (Font_loader *)data;
+    char done = 0;
+    int i;
+
+    for (i = 0; i < ploader->resolved; i++)
+    {
+        if (!ploader->requests[i].matched)
+            match_request(&ploader->requests[i]);
+    }
+    while (write(ploader->pipe_fds[1], &done, 1) == -1 && errno == EINTR)
+        ;
+    return NULL;
+}
+
+bool font_loader_init(Font_loader *ploader)
+{
+    ploader->requests = NULL;
+    ploader->count = 0;
+    ploader->size = 0;
+    ploader->resolved = 0;
+    ploader->opened = 0;
+    ploader->started = false;
+    ploader->pending = false;
+    ploader->threaded = false;
+    return pipe(ploader->pipe_fds) == 0;
+}
+
+int font_loader_request(Font_loader *ploader, Display *display,
+                        int screen_number, const char *name)
+{
+    Font_request *prequest;
+    int i, size;
+
+    for (i = 0; i < ploader->count; i++)
+    {
+        if (strcmp(ploader->requests[i].name, name) == 0)
+            return i;
+    }
+
+    /* The worker reads the requests */
+    font_loader_finish(ploader, display);
+    if (ploader->count == ploader->size)
+    {
+        size = ploader->size == 0 ? 8 : 2 * ploader->size;
+        prequest = (Font_request *)realloc(ploader->requests,
+                                           size * sizeof(Font_request));
+        if (prequest == NULL)
+            return -1;
+        ploader->requests = prequest;
+        ploader->size = size;
+    }
+
+    prequest = &ploader->requests[ploader->count];
+    prequest->pattern = XftNameParse(name);
+    prequest->name = strdup(name);
+    if (prequest->pattern == NULL || prequest->name == NULL)
+    {
+        fprintf(stderr, "Error: Font \"%s\" is not loaded\n", name);
+        if (prequest->pattern != NULL)
+            FcPatternDestroy(prequest->pattern);
+        free(prequest->name);
+        return -1;
+    }
+    /* Needs the display: done before fontconfig substitutes the pattern */
+    XftDefaultSubstitute(display, screen_number, prequest->pattern);
+    prequest->matched = false;
+    prequest->font = NULL;
+    ploader->count++;
+
+    if (ploader->started)
+    {
+        match_request(prequest);
+        open_request(prequest, display);
+        ploader->resolved = ploader->count;
+        ploader->opened = ploader->count;
+    }
+    return ploader->count - 1;
+}
+
+void font_loader_start(Font_loader *ploader)
+{
+    ploader->started = true;
+    ploader->resolved = ploader->count;
+    if (ploader->count == 0)
+        return;
+
+    ploader->pending = true;
+    ploader->threaded =
+        pthread_create(&ploader->thread, NULL, match_requests, ploader) == 0;
+    if (ploader->threaded)
+        print_loge("DEBUG: matching %d fonts in the background\n",
+                   ploader->count);
+    else
+        match_requests(ploader);
+}
+
+int font_loader_fd(const Font_loader *ploader)
+{
+    return ploader->pending ? ploader->pipe_fds[0] : -1;
+}
+
+void font_loader_finish(Font_loader *ploader, Display *display)
+{
+    char done;
+    int i;
+
+    if (!ploader->pending)
+        return;
+    if (ploader->threaded)
+        pthread_join(ploader->thread, NULL);
+    while (read(ploader->pipe_fds[0], &done, 1) == -1 && errno == EINTR)
+        ;
+    ploader->pending = false;
+    ploader->threaded = false;
+
+    for (i = ploader->opened; i < ploader->resolved; i++)
+        open_request(&ploader->requests[i], display);
+    ploader->opened = ploader->resolved;
+}
+
+XftFont *font_loader_get(Font_loader *ploader, Display *display, int index)
+{
+    if (index < 0 || ploader->requests[index].font == NULL)
+        return NULL;
+    /* Fonts are reference counted by Xft */
+    return XftFontCopy(display, ploader->requests[index].font);
+}
+
+void font_loader_free(Font_loader *ploader, Display *display)
+{
+    int i;
+
+    font_loader_finish(ploader, display);
+    for (i = 0; i < ploader->count; i++)
+    {
+        if (ploader->requests[i].font != NULL)
+            XftFontClose(display, ploader->requests[i].font);
+        else if (ploader->requests[i].pattern != NULL)
+            FcPatternDestroy(ploader->requests[i].pattern);
+        free(ploader->requests[i].name);
+    }
+    free(ploader->requests);
+    close(ploader->pipe_fds[0]);
+    close(ploader->pipe_fds[1]);
+}
@@ -0,0 +1,76 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FONTS_H
+#define FONTS_H
+
+#include <X11/Xft/Xft.h>
+#include <X11/Xlib.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+/* A font requested by name. Fontconfig may take hundreds of milliseconds to
+ * match a pattern on a cold cache, so patterns are matched by a worker thread
+ * while the bars are already drawn, and opened on the main thread. */
+typedef struct
+{
+    char *name;
+    FcPattern *pattern; /* Substituted, then matched (NULL on failure) */
+    bool matched;
+    XftFont *font; /* NULL until opened */
+} Font_request;
+
+typedef struct
+{
+    Font_request *requests;
+    int count;
+    int size;
+    int resolved; /* Requests before this one are matched or being matched */
+    int opened;   /* Requests before this one are opened */
+    bool started;  /* Later requests are matched right away */
+    bool pending;  /* A byte is or will be written to the pipe */
+    bool threaded; /* The worker is to be joined */
+    pthread_t thread;
+    int pipe_fds[2]; /* The worker writes a byte when done */
+} Font_loader;
+
+bool font_loader_init(Font_loader *ploader);
+
+/* Request a font by name, shared by every text using the same name. Returns
+ * its index, or -1 if the name cannot be parsed or memory runs out. Once the
+ * loader has been started, the font is opened right away: the worker must be
+ * finished first. */
+int font_loader_request(Font_loader *ploader, Display *display,
+                        int screen_number, const char *name);
+
+/* Match the fonts requested so far in the background. They are matched on
+ * the spot if no thread can be started. */
+void font_loader_start(Font_loader *ploader);
+
+/* Readable when the worker is done, -1 if it is not running */
+int font_loader_fd(const Font_loader *ploader);
+
+/* Wait for the worker and open the fonts it matched */
+void font_loader_finish(Font_loader *ploader, Display *display);
+
+/* Returns a new reference to the font of a request (to be closed with
+ * XftFontClose), or NULL if it is not loaded (yet) */
+XftFont *font_loader_get(Font_loader *ploader, Display *display, int index);
+
+void font_loader_free(Font_loader *ploader, Display *display);
+
+#endif /* __FONTS_H__ */
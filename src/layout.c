@@ -0,0 +1,149 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _XOPEN_SOURCE 500
+#include "layout.h"
+#include "log.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FNV-1a of the string, seeded with the font */
+static unsigned long hash_layout(XftFont *font, const char *string)
+{
+    unsigned long hash = 2166136261UL ^ (unsigned long)(size_t)font;
+
+    for (; *string != '\0'; string++)
+        hash = (hash ^ (unsigned char)*string) * 16777619UL;
+    return hash;
+}
+
+static void free_layout(Text_layout *playout)
+{
+    free(playout->string);
+    free(playout->glyphs);
+    free(playout->positions);
+    playout->last_use = 0;
+}
+
+/* Decode the string into glyphs of the font once and for all */
+static bool compute_layout(Text_layout *playout, Display *display,
+                           XftFont *font, const char *string)
+{
+    int length = strlen(string);
+    int char_count, char_width;
+    int i, read;
+    int x = 0, y = 0;
+    FcChar32 ucs4;
+    XGlyphInfo glyph_extents;
+
+    if (!FcUtf8Len((const FcChar8 *)string, length, &char_count, &char_width))
+        char_count = 0;
+
+    playout->string = strdup(string);
+    playout->glyphs = (FT_UInt *)malloc((char_count + 1) * sizeof(FT_UInt));
+    playout->positions = (XPoint *)malloc((char_count + 1) * sizeof(XPoint));
+    if (playout->string == NULL || playout->glyphs == NULL ||
+        playout->positions == NULL)
+    {
+        free(playout->string);
+        free(playout->glyphs);
+        free(playout->positions);
+        return false;
+    }
+
+    for (i = 0; i < char_count && length > 0; i++)
+    {
+        read = FcUtf8ToUcs4((const FcChar8 *)string, &ucs4, length);
+        if (read <= 0)
+            break;
+        playout->glyphs[i] = XftCharIndex(display, font, ucs4);
+        /* The pen advances by the offset of each glyph */
+        playout->positions[i].x = x;
+        playout->positions[i].y = y;
+        XftGlyphExtents(display, font, &playout->glyphs[i], 1,
+                        &glyph_extents);
+        x += glyph_extents.xOff;
+        y += glyph_extents.yOff;
+        string += read;
+        length -= read;
+    }
+    playout->glyph_count = i;
+    playout->font = font;
+    XftGlyphExtents(display, font, playout->glyphs, playout->glyph_count,
+                    &playout->extents);
+    return true;
+}
+
+void layout_cache_init(Layout_cache *pcache)
+{
+    int i;
+
+    for (i = 0; i < LAYOUT_CACHE_SIZE; i++)
+        pcache->entries[i].last_use = 0;
+    pcache->clock = 0;
+    pcache->hits = 0;
+    pcache->misses = 0;
+}
+
+const Text_layout *layout_lookup(Layout_cache *pcache, Display *display,
+                                 XftFont *font, const char *string)
+{
+    unsigned long hash = hash_layout(font, string);
+    Text_layout *pentry;
+    Text_layout *pvictim = &pcache->entries[0];
+    int i;
+
+    pcache->clock++;
+    for (i = 0; i < LAYOUT_CACHE_SIZE; i++)
+    {
+        pentry = &pcache->entries[i];
+        if (pentry->last_use != 0 && pentry->hash == hash &&
+            pentry->font == font && strcmp(pentry->string, string) == 0)
+        {
+            pentry->last_use = pcache->clock;
+            pcache->hits++;
+            return pentry;
+        }
+        /* A free entry, or else the least recently used one */
+        if (pentry->last_use < pvictim->last_use)
+            pvictim = pentry;
+    }
+
+    pcache->misses++;
+    print_loge("DEBUG: layout of [%s] computed (%lu hits, %lu misses)\n",
+               string, pcache->hits, pcache->misses);
+    if (pvictim->last_use != 0)
+        free_layout(pvictim);
+    if (!compute_layout(pvictim, display, font, string))
+        return NULL;
+    pvictim->hash = hash;
+    pvictim->last_use = pcache->clock;
+    return pvictim;
+}
+
+void layout_cache_free(Layout_cache *pcache)
+{
+    int i;
+
+    for (i = 0; i < LAYOUT_CACHE_SIZE; i++)
+    {
+        if (pcache->entries[i].last_use != 0)
+            free_layout(&pcache->entries[i]);
+    }
+}
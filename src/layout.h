@@ -0,0 +1,60 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <X11/Xft/Xft.h>
+#include <X11/Xlib.h>
+
+#define LAYOUT_CACHE_SIZE 128
+
+/* Glyphs and extents of a string in a font */
+typedef struct
+{
+    XftFont *font;
+    char *string;
+    unsigned long hash;
+    FT_UInt *glyphs;
+    XPoint *positions; /* Of each glyph from the origin of the string */
+    int glyph_count;
+    XGlyphInfo extents;
+    unsigned long last_use; /* 0 if the entry is free */
+} Text_layout;
+
+/* Layouts of the strings displayed recently, shared by all the bars. Dynamic
+ * texts cycle through a few values (e.g. percentages), which are then neither
+ * decoded nor measured again. */
+typedef struct
+{
+    Text_layout entries[LAYOUT_CACHE_SIZE];
+    unsigned long clock;
+    unsigned long hits;
+    unsigned long misses;
+} Layout_cache;
+
+void layout_cache_init(Layout_cache *pcache);
+
+/* Returns the layout of a string in a font, computed if it is not in the
+ * cache, in which case the least recently used layout is replaced. Returns
+ * NULL if memory runs out. The layout remains valid until the next lookup. */
+const Text_layout *layout_lookup(Layout_cache *pcache, Display *display,
+                                 XftFont *font, const char *string);
+
+void layout_cache_free(Layout_cache *pcache);
+
+#endif /* __LAYOUT_H__ */
@@ -21,25 +21,252 @@
 #include "display.h"
 #include "log.h"
 #include "parser.h"
+#include "reader.h"
+#include "server.h"
+#include "timer.h"
+#include <errno.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
 #include <time.h>
 #include <unistd.h>
 
+/* Polled file descriptors */
+#define POLL_INPUT 0
+#define POLL_X 1
+#define POLL_TIMERS 2
+#define POLL_FONTS 3
+#define POLL_SERVER 4
+#define POLL_CLIENTS 5
+#define POLL_COUNT (POLL_CLIENTS + SERVER_MAX_CLIENTS)
+
+/* Create the display context of a look */
+static void init_look(Display_setup *psetup, Look *plook)
+{
+    /* Fonts requested once the loader started are opened right away, which
+     * must wait for the worker (the other bars get their fonts meanwhile) */
+    if (font_loader_fd(&psetup->connection.fonts) != -1)
+        handle_fonts(&psetup->connection, psetup->display_contexts,
+                     psetup->display_context_count);
+    plook->display_context =
+        init(&psetup->connection, psetup->styles[plook->style]);
+    plook->initialized = true;
+    psetup->display_contexts[psetup->display_context_count++] =
+        &plook->display_context;
+}
+
+/* Look of a bar for a style name, its own style if NULL or unknown.
+ * Initialized on first use. */
+static Look *find_look(Display_setup *psetup, Bar *pbar, const char *style)
+{
+    int i;
+
+    for (i = 0; style != NULL && i < pbar->look_count &&
+                strcmp(pbar->looks[i].name, style) != 0;
+         i++)
+        ;
+    if (i == pbar->look_count)
+    {
+        fprintf(stderr, "Error: No style %s.\n", style);
+        i = 0;
+    }
+
+    if (!pbar->looks[i].initialized)
+        init_look(psetup, &pbar->looks[i]);
+    return &pbar->looks[i];
+}
+
+/* Connect to the display and initialize the own look of every bar. Every bar
+ * shares the connection, its colormap and the fonts. The other styles are
+ * only initialized for a bar when a value switches to them. */
+static void start_display(Display_setup *psetup, Bar *bars, int bar_count)
+{
+    int i;
+
+    if (psetup->started)
+        return;
+    print_loge_once("DEBUG: connecting to the display\n");
+    psetup->connection = connect_display(psetup->renderer_name);
+    if (psetup->connection.display == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open display\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < bar_count; i++)
+        init_look(psetup, &bars[i].looks[0]);
+
+    /* The bars can be shown while fontconfig matches their fonts */
+    font_loader_start(&psetup->connection.fonts);
+    psetup->started = true;
+}
+
+/* Display an input value and report it on the standard output. A value the
+ * bar rejects is skipped. */
+static void update(Display_setup *psetup, Bar *pbar, Bar *bars, int bar_count,
+                   const Options *poptions, Timer_queue *ptimers,
+                   Input_value input_value, char **words_list)
+{
+    Look *plook;
+
+    /* Lazy initialization: the first valid value creates the bars */
+    start_display(psetup, bars, bar_count);
+    plook = find_look(psetup, pbar, input_value.style);
+    if (!show(&plook->display_context, input_value.value, poptions->cap,
+              plook->overflow, input_value.show_mode, words_list))
+        return;
+    if (poptions->idle > 0)
+        timer_cancel(ptimers, plook->release_timer);
+    /* Switching style: the previous look is hidden once the new one is shown */
+    if (plook != pbar->current_look)
+    {
+        hide(&pbar->current_look->display_context);
+        if (poptions->idle > 0)
+            timer_set(ptimers, pbar->current_look->release_timer,
+                      poptions->idle);
+        pbar->current_look = plook;
+    }
+    printf("Update: %d/%d %s\n", input_value.value, poptions->cap,
+           (input_value.show_mode == ALTERNATIVE) ? "[ALT]" : "");
+
+    pbar->displayed = true;
+    if (poptions->timeout > 0)
+        timer_set(ptimers, pbar->hide_timer, poptions->timeout);
+}
+
+/* Bar named by the first word of a line, which is then skipped. Lines without
+ * a channel name go to the first bar. */
+static Bar *select_bar(Bar *bars, int bar_count, char **pline)
+{
+    char *word = *pline + strspn(*pline, " ");
+    size_t length = strcspn(word, " ");
+    int i;
+
+    for (i = 0; i < bar_count; i++)
+    {
+        if (strlen(bars[i].name) == length &&
+            strncmp(bars[i].name, word, length) == 0)
+        {
+            *pline = word + length;
+            return &bars[i];
+        }
+    }
+    return &bars[0];
+}
+
+/* Whether a bar is on screen */
+static bool any_displayed(const Bar *bars, int bar_count)
+{
+    int i;
+
+    for (i = 0; i < bar_count; i++)
+    {
+        if (bars[i].displayed)
+            return true;
+    }
+    return false;
+}
+
+/* Display the lines available in a reader or, when coalescing, keep the
+ * newest one for later. Stops at a line that is not a value and sets
+ * *pinvalid. */
+static void read_lines(Display_setup *psetup, Line_reader *preader,
+                       bool *pinvalid, Bar *bars, int bar_count,
+                       const Options *poptions, Timer_queue *ptimers)
+{
+    char *line;
+    Word_list *pwords_list;
+    Input_value input_value;
+    Bar *pbar;
+
+    while ((line = reader_next_line(preader)) != NULL)
+    {
+        pbar = select_bar(bars, bar_count, &line);
+        pwords_list = &pbar->words_lists[pbar->current_words];
+        input_value = parse_input(line, pwords_list);
+        if (!input_value.valid)
+        {
+            *pinvalid = true;
+            return;
+        }
+
+        if (poptions->coalesce)
+        {
+            if (pbar->pending)
+                pbar->dropped++;
+            pbar->pending = true;
+            pbar->pending_value = input_value;
+            pbar->pending_words = pbar->current_words;
+            pbar->current_words = !pbar->current_words;
+        }
+        else
+            update(psetup, pbar, bars, bar_count, poptions, ptimers,
+                   input_value, pwords_list->words);
+    }
+}
+
+/* Display the newest value of a burst if any. Its input is still open: the
+ * values are flushed on the wakeup they are read on. */
+static void flush_pending(Display_setup *psetup, Bar *pbar, Bar *bars,
+                          int bar_count, const Options *poptions,
+                          Timer_queue *ptimers)
+{
+    if (!pbar->pending)
+        return;
+
+    update(psetup, pbar, bars, bar_count, poptions, ptimers,
+           pbar->pending_value, pbar->words_lists[pbar->pending_words].words);
+    if (pbar->dropped > 0)
+    {
+        printf("Dropped: %d\n", pbar->dropped);
+        pbar->total_dropped += pbar->dropped;
+    }
+    pbar->pending = false;
+    pbar->dropped = 0;
+}
+
+#ifdef DEBUG
+static long elapsed_us(struct timespec since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since.tv_sec) * 1000000 +
+           (now.tv_nsec - since.tv_nsec) / 1000;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
     int cap = 100;
     int timeout = 1000;
+    int idle = 0;
+    bool coalesce = false;
+    bool lazy = false;
 
     char *arg_config_file_path = NULL;
-    char *style_name = DEFAULT_STYLE;
+    char *socket_path = NULL;
+    char *fifo_path = NULL;
+    char *renderer_name = "auto";
+    /* One bar per style, at most one style per argument */
+    char **style_names = (char **)calloc(argc, sizeof(char *));
+    int bar_count = 0;
+#ifdef DEBUG
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+#endif
+
+    if (style_names == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate the list of styles\n");
+        exit(EXIT_FAILURE);
+    }
 
     /* Command-line arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "m:t:c:s:qvh")) != -1)
+    int i;
+    while ((opt = getopt(argc, argv, "m:t:i:c:s:bu:p:r:lqvh")) != -1)
     {
         switch (opt)
         {
@@ -72,11 +299,51 @@ int main(int argc, char *argv[])
                     "Warning: timeout is low, the bar may not be visible.\n");
             }
             break;
+        case 'i':
+            idle = atoi(optarg);
+            if (idle < 0)
+            {
+                fprintf(stderr,
+                        "Invalid idle time: must be a natural number.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'c':
             arg_config_file_path = optarg;
             break;
         case 's':
-            style_name = optarg;
+            for (i = 0; i < bar_count; i++)
+            {
+                if (strcmp(style_names[i], optarg) == 0)
+                {
+                    fprintf(stderr, "Invalid style: %s is used twice.\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            style_names[bar_count++] = optarg;
+            break;
+        case 'b':
+            coalesce = true;
+            break;
+        case 'u':
+            socket_path = optarg;
+            break;
+        case 'p':
+            fifo_path = optarg;
+            break;
+        case 'r':
+            if (strcmp(optarg, "auto") != 0 && find_renderer(optarg) == NULL)
+            {
+                fprintf(stderr, "Invalid renderer: must be auto or one of: ");
+                print_renderers(stderr);
+                fprintf(stderr, ".\n");
+                exit(EXIT_FAILURE);
+            }
+            renderer_name = optarg;
+            break;
+        case 'l':
+            lazy = true;
             break;
         case 'q':
             freopen("/dev/null", "w", stdout);
@@ -87,8 +354,9 @@ int main(int argc, char *argv[])
             break;
         default:
             fprintf(stderr,
-                    "Usage: %s [-m maximum] [-t timeout] [-c configfile] [-s "
-                    "style]\n\n",
+                    "Usage: %s [-m maximum] [-t timeout] [-i idle] [-c "
+                    "configfile] [-s style] [-b] [-u socket] [-p fifo] [-r "
+                    "renderer] [-l]\n\n",
                     argv[0]);
             fprintf(stderr, "    -m <non-zero natural>"
                             " maximum value (0 is always the minimum)\n");
@@ -97,10 +365,30 @@ int main(int argc, char *argv[])
                     " duration in milliseconds between an update and the "
                     "vanishing of the bar "
                     "after an update or 0 if always on screen\n");
+            fprintf(stderr, "    -i <natural>         "
+                            " duration in milliseconds after which a hidden "
+                            "bar frees its resources or 0 if never\n");
             fprintf(stderr, "    -c <filepath>        "
                             " configuration file specifying styles\n");
             fprintf(stderr, "    -s <style name>      "
-                            " style to use from the configuration file\n");
+                            " style to use from the configuration file, "
+                            "repeat for several bars\n");
+            fprintf(stderr, "    -b                   "
+                            " only display the newest value of a burst of "
+                            "input\n");
+            fprintf(stderr, "    -u <filepath>        "
+                            " read input from clients of a UNIX socket "
+                            "instead of stdin\n");
+            fprintf(stderr, "    -p <filepath>        "
+                            " read input from a named pipe instead of stdin\n");
+            fprintf(stderr, "    -r <renderer>        "
+                            " rendering backend: auto (fastest on the "
+                            "display) or one of: ");
+            print_renderers(stderr);
+            fprintf(stderr, "\n");
+            fprintf(stderr, "    -l                   "
+                            " connect to the display on the first value "
+                            "only\n");
             fprintf(stderr, "    -q                   "
                             " suppress all normal output\n");
             fprintf(stderr, "    -v                   "
@@ -109,9 +397,17 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (bar_count == 0)
+        style_names[bar_count++] = DEFAULT_STYLE;
+
     /* Style */
     FILE *config_file = NULL;
-    Style style = DEFAULT_CONFIGURATION;
+    char **config_style_names = NULL;
+    int config_style_count = 0;
+    Style *styles;
+    Style default_style = DEFAULT_CONFIGURATION;
+    int own_style;
+    int j;
     char xdg_config_file_path[PATH_MAX];
     char real_config_file_path[PATH_MAX];
 
@@ -170,160 +466,389 @@ int main(int argc, char *argv[])
         }
     }
 
-    /* Parsing the config file */
-    printf("Info: reading configuration from %s.\n", real_config_file_path);
-    style = parse_style_config(config_file, style_name, style);
-    fclose(config_file);
+    /* Parsing every style of the config file once */
+    if (config_file != NULL)
+    {
+        printf("Info: reading configuration from %s.\n",
+               real_config_file_path);
+        config_style_names =
+            parse_style_names(config_file, &config_style_count);
+    }
+    else
+    {
+        fprintf(stderr, "Info: no configuration file, using the default "
+                        "style.\n");
+    }
+    styles = (Style *)calloc(config_style_count + 1, sizeof(Style));
+    if (styles == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate the styles\n");
+        exit(EXIT_FAILURE);
+    }
+    for (j = 0; j < config_style_count; j++)
+    {
+        rewind(config_file);
+        styles[j] = parse_style_config(config_file, config_style_names[j],
+                                       default_style);
+    }
+    /* Bars whose style is missing */
+    styles[config_style_count] = default_style;
+    if (config_file != NULL)
+        fclose(config_file);
 
     /* Display */
-    bool displayed = false;
     bool listening = true;
-    Input_value input_value;
-    Display_context display_context = init(style);
+    bool input_closed = false;
+    /* The socket replaces the standard input, not the named pipe */
+    bool use_reader = socket_path == NULL || fifo_path != NULL;
+    bool stopping;
+    int expired_timer;
+    /* Hide timers of the bars, then release timers of their looks */
+    int look_stride = config_style_count + 1;
+    Look *plook;
+    long total_dropped;
+    Read_status read_status;
+    Line_reader reader;
+    Server server;
+    Timer_queue timers;
+    Options options = {
+        .cap = cap, .timeout = timeout, .idle = idle, .coalesce = coalesce};
+    Display_setup setup = {.started = false,
+                           .renderer_name = renderer_name,
+                           .styles = styles,
+                           .style_count = config_style_count,
+                           .display_context_count = 0};
+    Bar *bars = (Bar *)calloc(bar_count, sizeof(Bar));
+#ifdef DEBUG
+    struct timespec wakeup_time;
+#endif
+
+    setup.display_contexts = (Display_context **)calloc(
+        bar_count * (config_style_count + 1), sizeof(Display_context *));
+    if (bars == NULL || setup.display_contexts == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate the bars\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Looks of the bars, initialized with the display */
+    for (i = 0; i < bar_count; i++)
+    {
+        bars[i].name = style_names[i];
+        bars[i].hide_timer = i;
+        bars[i].looks = (Look *)calloc(look_stride, sizeof(Look));
+        if (bars[i].looks == NULL)
+        {
+            fprintf(stderr, "Error: Cannot allocate the bars\n");
+            exit(EXIT_FAILURE);
+        }
+        for (j = 0; j < look_stride; j++)
+            bars[i].looks[j].release_timer = bar_count + i * look_stride + j;
 
-    style_free(&style);
+        for (own_style = 0; own_style < config_style_count &&
+                            strcmp(config_style_names[own_style],
+                                   style_names[i]) != 0;
+             own_style++)
+            ;
+        if (own_style == config_style_count && config_file != NULL)
+            fprintf(stderr, "Error: No style %s.\n", style_names[i]);
 
-    char *words_list[MAX_DYN_STR_SIZE + 1]; // TODO dymamic list length
+        /* The own style of the bar comes first */
+        bars[i].looks[0].name = style_names[i];
+        bars[i].looks[0].style = own_style;
+        bars[i].looks[0].overflow = styles[own_style].overflow;
+        bars[i].look_count = 1;
+        for (j = 0; j < config_style_count; j++)
+        {
+            if (j == own_style)
+                continue;
+            bars[i].looks[bars[i].look_count].name = config_style_names[j];
+            bars[i].looks[bars[i].look_count].style = j;
+            bars[i].looks[bars[i].look_count].overflow = styles[j].overflow;
+            bars[i].look_count++;
+        }
+        bars[i].current_look = &bars[i].looks[0];
+    }
 
-    if (display_context.x.display == NULL)
+    /* Unless deferred until the first valid value */
+    if (!lazy)
+        start_display(&setup, bars, bar_count);
+
+    if (fifo_path != NULL && !reader_init_fifo(&reader, fifo_path))
+    {
+        exit(EXIT_FAILURE);
+    }
+    else if (fifo_path == NULL && use_reader &&
+             !reader_init(&reader, STDIN_FILENO))
+    {
+        fprintf(stderr, "Error: Cannot allocate the input buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    else if (socket_path != NULL && !server_open(&server, socket_path))
     {
-        fprintf(stderr, "Error: Cannot open display\n");
+        exit(EXIT_FAILURE);
+    }
+    else if (!timers_init(&timers, bar_count + bar_count * look_stride))
+    {
+        perror("timerfd_create()");
         exit(EXIT_FAILURE);
     }
     else
     {
-        fd_set fds;
-        struct timeval tv;
+        struct pollfd fds[POLL_COUNT];
+
+        for (i = 0; i < POLL_COUNT; i++)
+        {
+            fds[i].fd = -1;
+            fds[i].events = POLLIN;
+        }
+        fds[POLL_TIMERS].fd = timers.fd;
+
+        if (socket_path != NULL)
+            printf("Info: listening on %s.\n", socket_path);
+        if (fifo_path != NULL)
+            printf("Info: reading from %s.\n", fifo_path);
+        print_loge("DEBUG: ready after %ld us\n", elapsed_us(start_time));
 
         /* Main loop */
         while (listening)
         {
-            /* Waiting for input on stdin or time to hide the gauge */
-            FD_ZERO(&fds);
-            FD_SET(STDIN_FILENO, &fds);
-            tv.tv_sec = timeout / 1000;
-            tv.tv_usec = 1000 * (timeout % 1000);
-            switch (select(1, &fds, NULL, NULL,
-                           /* No timeout if already hidden */
-                           displayed && timeout > 0 ? &tv : NULL))
+            /* X events may already be queued by Xlib, the file descriptor
+             * is only polled for new ones. Fonts are loaded in the
+             * background. */
+            if (setup.started)
+            {
+                handle_events(&setup.connection, setup.display_contexts,
+                              setup.display_context_count);
+                fds[POLL_X].fd = ConnectionNumber(setup.connection.display);
+                fds[POLL_FONTS].fd = font_loader_fd(&setup.connection.fonts);
+            }
+
+            /* Input sources */
+            if (use_reader)
+                fds[POLL_INPUT].fd = input_closed ? -1 : reader.fd;
+            if (socket_path != NULL)
+            {
+                fds[POLL_SERVER].fd = !input_closed && server_has_room(&server)
+                                          ? server.fd
+                                          : -1;
+                for (i = 0; i < SERVER_MAX_CLIENTS; i++)
+                    fds[POLL_CLIENTS + i].fd =
+                        !input_closed && server.clients[i].connected
+                            ? server.clients[i].reader.fd
+                            : -1;
+            }
+
+            /* Waiting for input, X events, or time to hide the gauge */
+            if (poll(fds, POLL_COUNT, -1) == -1)
             {
-            case -1:
-                print_loge_once("DEBUG: select error\n");
-                perror("select()");
+                if (errno == EINTR)
+                    continue;
+                print_loge_once("DEBUG: poll error\n");
+                perror("poll()");
                 exit(EXIT_FAILURE);
-            case 0:
-                /* Time to hide the gauge */
-                print_loge_once("DEBUG: select timeout, hide the bar\n");
-                hide(&display_context);
-                displayed = false;
-                break;
-            default:
-                /* Update display using new input value */
-                input_value = parse_input(words_list, MAX_DYN_STR_SIZE + 1);
-                if (input_value.valid)
+            }
+#ifdef DEBUG
+            clock_gettime(CLOCK_MONOTONIC, &wakeup_time);
+#endif
+
+            if (fds[POLL_TIMERS].revents != 0)
+            {
+                timers_acknowledge(&timers);
+                while ((expired_timer = timers_pop_expired(&timers)) != -1)
                 {
-                    show(&display_context, input_value.value, cap,
-                         style.overflow, input_value.show_mode, words_list);
-                    printf("Update: %d/%d %s\n", input_value.value, cap,
-                           (input_value.show_mode == ALTERNATIVE) ? "[ALT]"
-                                                                  : "");
-                    displayed = true;
-                    listening = true;
+                    if (expired_timer >= bar_count)
+                    {
+                        /* Hidden for long: free the resources of the look */
+                        plook = &bars[(expired_timer - bar_count) / look_stride]
+                                     .looks[(expired_timer - bar_count) %
+                                            look_stride];
+                        release(&plook->display_context);
+                        continue;
+                    }
+
+                    /* Time to hide a gauge */
+                    print_loge_once("DEBUG: hide timer expired\n");
+                    hide(&bars[expired_timer].current_look->display_context);
+                    bars[expired_timer].displayed = false;
+                    if (idle > 0)
+                        timer_set(
+                            &timers,
+                            bars[expired_timer].current_look->release_timer,
+                            idle);
+                    listening =
+                        !input_closed || any_displayed(bars, bar_count);
                 }
-                else
+            }
+
+            if (fds[POLL_FONTS].revents != 0)
+            {
+                handle_fonts(&setup.connection, setup.display_contexts,
+                             setup.display_context_count);
+                print_loge("DEBUG: fonts loaded after %ld us\n",
+                           elapsed_us(start_time));
+            }
+
+            /* Update display using every line available */
+            stopping = false;
+            if (fds[POLL_INPUT].revents != 0)
+            {
+                read_status = reader_fill(&reader);
+                if (read_status == READ_ERROR)
+                    perror("read()");
+                /* Stop after unexpected input or at the end of the input */
+                stopping = read_status != READ_AGAIN;
+                read_lines(&setup, &reader, &stopping, bars, bar_count,
+                           &options, &timers);
+            }
+            for (i = 0; i < SERVER_MAX_CLIENTS; i++)
+            {
+                if (fds[POLL_CLIENTS + i].revents != 0)
+                {
+                    read_status = reader_fill(&server.clients[i].reader);
+                    if (read_status == READ_ERROR)
+                        perror("read()");
+                    /* Forget the client after unexpected input or at the end
+                     * of its input, the other clients are still served */
+                    server.clients[i].closing = read_status != READ_AGAIN;
+                    read_lines(&setup, &server.clients[i].reader,
+                               &server.clients[i].closing, bars, bar_count,
+                               &options, &timers);
+                }
+            }
+            for (i = 0; i < bar_count; i++)
+                flush_pending(&setup, &bars[i], bars, bar_count, &options,
+                              &timers);
+            print_loge("DEBUG: wakeup processed in %ld us\n",
+                       elapsed_us(wakeup_time));
+
+            /* The lines of the clients are not needed anymore */
+            if (socket_path != NULL)
+            {
+                server_close_clients(&server);
+                if (fds[POLL_SERVER].revents != 0)
+                    server_accept(&server);
+            }
+
+            /* Stop reading, then leave as soon as the bar is hidden */
+            if (stopping)
+            {
+                print_loge_once("DEBUG: end of input\n");
+                input_closed = true;
+                if (!any_displayed(bars, bar_count) || timeout == 0)
                 {
-                    /* Stop after unexpected input */
-                    struct timespec wait_time = {timeout / 1000,
-                                                 1000 * (timeout % 1000)};
-                    nanosleep(&wait_time, NULL); // Waiting for timeout
-                    hide(&display_context);
+                    for (i = 0; i < bar_count && setup.started; i++)
+                        hide(&bars[i].current_look->display_context);
                     listening = false;
                 }
-                free_input_value(&input_value);
-                break;
             }
         }
 
+        if (coalesce)
+        {
+            total_dropped = 0;
+            for (i = 0; i < bar_count; i++)
+                total_dropped += bars[i].total_dropped;
+            printf("Info: %ld updates dropped by coalescing.\n",
+                   total_dropped);
+        }
+
         /* Clean the memory */
-        display_context_destroy(&display_context);
+        timers_free(&timers);
+        if (use_reader)
+            reader_free(&reader);
+        if (socket_path != NULL)
+            server_close(&server);
+        for (i = 0; i < bar_count; i++)
+        {
+            for (j = 0; j < bars[i].look_count; j++)
+            {
+                if (bars[i].looks[j].initialized)
+                    display_context_destroy(
+                        &bars[i].looks[j].display_context);
+            }
+            free(bars[i].looks);
+            free(bars[i].words_lists[0].words);
+            free(bars[i].words_lists[1].words);
+        }
+        if (setup.started)
+            disconnect_display(&setup.connection);
+        for (j = 0; j < config_style_count; j++)
+            style_free(&styles[j]);
+        free(styles);
+        free(setup.display_contexts);
+        free(bars);
+        free(style_names);
+        style_names_free(config_style_names, config_style_count);
     }
     return EXIT_SUCCESS;
 }
 
-Input_value parse_input(char **words_list, int size)
+/* Make room for more words in a list. Returns false on failure. */
+static bool grow_word_list(Word_list *pwords_list)
+{
+    int size = pwords_list->size > 0 ? 2 * pwords_list->size : 16;
+    char **words = (char **)realloc(pwords_list->words, size * sizeof(char *));
+
+    if (words == NULL)
+        return false;
+    pwords_list->words = words;
+    pwords_list->size = size;
+    return true;
+}
+
+Input_value parse_input(char *line, Word_list *pwords_list)
 {
     print_loge_once("DEBUG: parse_input()\n");
     Input_value input_value;
-    char altflag;
 
-    // char input_string[200];     // TODO dynamic length
-    // TODO change malloc to something more simple
-    input_value.input_string = (char *)malloc(sizeof(char) * 200);
-    char *inp_word;
+    char **words_list;
+    char *flags;
     int word_index;
-    int num_len, temp_num;
 
     input_value.valid = false;
-
-    /* Get input */
-    char *read_status = fgets(input_value.input_string, 200, stdin);
-    if (read_status == NULL)
-    {
-        print_loge_once("DEBUG: read_status is NULL\n");
-        return input_value;
-    }
-    else
-    {
-        print_loge_once("DEBUG: read_status is not NULL\n");
-    }
-    input_value.input_string[strlen(input_value.input_string) - 1] = '\0';
+    input_value.style = NULL;
+    input_value.input_string = line;
     print_loge("DEBUG: input_value.input_string is [%s]\n",
                input_value.input_string);
 
     /* Split line by tokens */
-    if (strlen(input_value.input_string) > 0)
-    {
-        inp_word = parse_splitted(input_value.input_string);
-        words_list[0] = inp_word;
-    }
-    else
-    {
+    if (strlen(input_value.input_string) == 0)
         return input_value;
-    }
 
-    for (word_index = 1; word_index < size - 1; word_index++)
+    for (word_index = 0;; word_index++)
     {
-        words_list[word_index] = parse_splitted(NULL);
-        if (words_list[word_index] == NULL)
+        /* Room for the word and the terminating NULL */
+        if (word_index + 1 >= pwords_list->size &&
+            !grow_word_list(pwords_list))
+        {
+            fprintf(stderr, "Error: Cannot allocate the list of words\n");
+            return input_value;
+        }
+        pwords_list->words[word_index] =
+            parse_splitted(word_index == 0 ? input_value.input_string : NULL);
+        if (pwords_list->words[word_index] == NULL)
             break;
     }
-
-    if (sscanf(words_list[0], "%d", &(input_value.value)) > 0)
+    words_list = pwords_list->words;
+    input_value.value = (int)strtol(words_list[0], &flags, 10);
+    if (flags != words_list[0])
     {
-        // checking for the "alternative mode"
-        input_value.show_mode = NORMAL;
-
-        /* Calculate input_value.value length */
-        temp_num = input_value.value;
-        num_len = 0;
-        while (temp_num > 0)
-        {
-            num_len++;
-            temp_num /= 10;
-        }
-
         /* Checking for the "alternative mode" flag : '!' */
-        if (sscanf(words_list[0] + num_len, "%c", &altflag) > 0 &&
-            altflag == '!')
+        input_value.show_mode = NORMAL;
+        if (flags[0] == '!')
         {
-            print_loge("DEBUG: Input_value parse_input altflag is '%c'\n",
-                       altflag);
+            print_loge_once("DEBUG: Input_value parse_input altflag is '!'\n");
             input_value.show_mode = ALTERNATIVE;
+            flags++;
         }
-        else
+
+        /* Checking for a style to switch to : '@style' */
+        if (flags[0] == '@' && flags[1] != '\0')
         {
-            // print_loge("DEBUG: Input_value parse_input altflag is NULL\n");
-            input_value.show_mode = NORMAL;
+            input_value.style = flags + 1;
+            print_loge("DEBUG: Input_value parse_input style is [%s]\n",
+                       input_value.style);
         }
 
         input_value.valid = true;
@@ -331,8 +856,3 @@ Input_value parse_input(char **words_list, int size)
 
     return input_value;
 }
-
-void free_input_value(Input_value *p_input_value)
-{
-    free(p_input_value->input_string);
-}
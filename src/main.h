@@ -19,6 +19,7 @@
 #define MAIN_H
 
 #include "display.h"
+#include "parser.h"
 #include <stdbool.h>
 
 #define VERSION_NUMBER "0.3"
@@ -28,9 +29,75 @@ typedef struct
     bool valid;
     int value;
     Show_mode show_mode;
+    const char *style; /* Style to display the value with, NULL by default */
     char *input_string;
 } Input_value;
 
-Input_value parse_input(char ** words_list, int size);
-void free_input_value(Input_value * p_input_value);
+typedef struct
+{
+    int cap;
+    int timeout;
+    int idle; /* Hidden time after which the looks free their resources */
+    bool coalesce;
+} Options;
+
+/* Words of a line of input, terminated by NULL. The array grows with the
+ * number of words. */
+typedef struct
+{
+    char **words;
+    int size;
+} Word_list;
+
+/* A style of a bar, initialized the first time it is used and kept */
+typedef struct
+{
+    const char *name;
+    int style; /* Index of the style to initialize the look with */
+    bool initialized;
+    int release_timer; /* Armed while the look is hidden */
+    Display_context display_context;
+    Overflow_mode overflow;
+} Look;
+
+/* A bar, named after its style, and the input waiting to be displayed on it.
+ * Every style of the configuration is one of its looks, the first one being
+ * its own style. */
+typedef struct
+{
+    const char *name;
+    Look *looks;
+    int look_count;
+    Look *current_look;
+    bool displayed;
+    int hide_timer;
+
+    /* Coalescing: newest value of the current burst. Its words are kept in
+     * one list while the next lines are parsed into the other one. */
+    bool pending;
+    Input_value pending_value;
+    int pending_words;
+    int current_words;
+    int dropped;
+    long total_dropped;
+    Word_list words_lists[2];
+} Bar;
+
+/* The connection to the display and the resources of the bars, created at
+ * startup or, lazily, when the first valid value arrives. The styles are
+ * kept for the looks initialized later. */
+typedef struct
+{
+    bool started;
+    const char *renderer_name;
+    Style *styles;
+    int style_count;
+    X_connection connection;
+    Display_context **display_contexts;
+    int display_context_count;
+} Display_setup;
+
+/* Parse a line of input, splitting it in a list of words. The line is
+ * modified in place. */
+Input_value parse_input(char *line, Word_list *pwords_list);
 #endif
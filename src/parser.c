@@ -19,153 +19,215 @@
 
 #include <ctype.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* Maximum length of a formatted long */
+#define NUMBER_LENGTH 24
+
+static void append_literal(Dynamic_string *pdyn_str, int *pliterals_length,
+                           const char *str, int length)
+{
+    Dynamic_op *plast = pdyn_str->op_count > 0
+                            ? &pdyn_str->ops[pdyn_str->op_count - 1]
+                            : NULL;
+
+    /* Literals interrupted by an escaped brace are a single span */
+    if (plast == NULL || plast->kind != OP_LITERAL)
+    {
+        plast = &pdyn_str->ops[pdyn_str->op_count++];
+        plast->kind = OP_LITERAL;
+        plast->start = *pliterals_length;
+        plast->length = 0;
+    }
+    memcpy(pdyn_str->literals + *pliterals_length, str, length);
+    *pliterals_length += length;
+    plast->length += length;
+}
+
+/* Parse a placeholder starting with {. Returns a pointer past its closing
+ * brace, or NULL if the syntax is not correct. */
+static const char *parse_placeholder(const char *str, Dynamic_op *pop)
+{
+    char *end;
+    long index;
+    long width = 0;
+
+    if (!isdigit((unsigned char)str[1]))
+        return NULL;
+    index = strtol(str + 1, &end, 10);
+
+    pop->kind = OP_WORD;
+    pop->zero_padding = false;
+    pop->percent = false;
+    if (end[0] == ':')
+    {
+        pop->kind = OP_NUMBER;
+        end++;
+        if (end[0] == '0')
+        {
+            pop->zero_padding = true;
+            end++;
+        }
+        if (isdigit((unsigned char)end[0]))
+            width = strtol(end, &end, 10);
+        if (end[0] == '%')
+        {
+            pop->percent = true;
+            end++;
+        }
+    }
+    if (end[0] != '}' || index >= INT_MAX || width > MAX_DYN_STR_WIDTH)
+        return NULL;
+
+    pop->index = index;
+    pop->width = width;
+    return end + 1;
+}
+
 Dynamic_string generate_dyn_str(const char *str)
 {
     Dynamic_string dyn_str;
-    char *start;
-    char *end = strchr(str, '\0');
-    const char *lead = str;
-    int index;
-    int s_result;
-    int loop = 0;
-    char buffer[strlen(str) + 1];
-    int buffer_size = 0;
-    buffer[0] = '\0';
+    int length = strlen(str);
+    int literals_length = 0;
+    const char *next;
 
+    /* Every operation takes one character at least */
+    dyn_str.literals = (char *)malloc(length + 1);
+    dyn_str.ops = (Dynamic_op *)malloc(sizeof(Dynamic_op) * (length + 1));
+    dyn_str.op_count = 0;
     dyn_str.inserts = 0;
-    dyn_str.count_strings = 0;
+    dyn_str.words = 0;
+    if (dyn_str.literals == NULL || dyn_str.ops == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate the dynamic string.\n");
+        exit(EXIT_FAILURE);
+    }
 
-    while (loop == 0)
+    while (str[0] != '\0')
     {
-        start = strchr(lead, '{');
-        if (start == NULL)
+        if (str[0] == '{' && str[1] == '{')
         {
-            loop = 1;
-            break;
+            append_literal(&dyn_str, &literals_length, str, 1);
+            str += 2;
         }
-        else if (end - start > 1)
+        else if (str[0] == '{' &&
+                 (next = parse_placeholder(
+                      str, &dyn_str.ops[dyn_str.op_count])) != NULL)
         {
-            if (isdigit(start[1])) // Define if the next symbol
-            {                      // after { is digit
-                s_result = sscanf(&start[1], "%d", &index);
-
-                if (start[s_result + 1] != '}') // Check if } exists after
-                {                               // number
-                    loop = 1;
-                    break;
-                }
-
-                dyn_str.indexes[dyn_str.inserts] = index; // set indexes
-                dyn_str.inserts++;
-
-                /* Copy text before { to the buffer */
-                strncat(buffer, lead, start - lead);
-                buffer[buffer_size + start - lead + 1] = '\0';
-                buffer_size += start - lead;
-
-                lead = start + s_result + 2;
-
-                dyn_str.strings[dyn_str.count_strings] =
-                    (char *)malloc(sizeof(char) * strlen(buffer) + 1);
-                strncpy(dyn_str.strings[dyn_str.count_strings], buffer,
-                        strlen(buffer) + 1);
-                dyn_str.count_strings++;
-                buffer[0] = '\0';
-                buffer_size = 0;
-
-                continue;
-            }
-            else if (start[1] == '{')
-            {
-                strncat(buffer, lead, start - lead);
-                buffer[buffer_size + start - lead + 1] = '\0';
-                buffer_size += start - lead;
-                buffer[buffer_size - 0] = '{';
-
-                lead = start + 2;
-                continue;
-            }
-            else
-            {
-                fprintf(stderr, "Error: Not correct syntax, ignore the end of"
-                                " the string.\n");
-                loop = 1;
-                break;
-            }
+            if (dyn_str.ops[dyn_str.op_count].index >= dyn_str.words)
+                dyn_str.words = dyn_str.ops[dyn_str.op_count].index + 1;
+            dyn_str.op_count++;
+            dyn_str.inserts++;
+            str = next;
         }
         else
         {
-            fprintf(stderr, "Error: something goes wrong.\n");
+            if (str[0] == '{')
+                fprintf(stderr, "Error: Not correct syntax, the brace is "
+                                "kept as is.\n");
+            append_literal(&dyn_str, &literals_length, str, 1);
+            str++;
         }
     }
 
-    switch (loop)
-    {
-    case 0:
-        break;
-    case 1:
-        strncat(buffer, lead, end - lead);
-        buffer[buffer_size + end - lead + 1] = '\0';
-        buffer_size += end - lead;
-
-        dyn_str.strings[dyn_str.count_strings] =
-            (char *)malloc(sizeof(char) * strlen(buffer) + 1);
-        strncpy(dyn_str.strings[dyn_str.count_strings], buffer,
-                strlen(buffer) + 1);
-        dyn_str.count_strings++;
-        buffer[0] = '\0';
-        buffer_size = 0;
-
-        break;
-    default:
-        break;
-    }
+    return dyn_str;
+}
 
-    int dyn_str_len = 0;
+void free_dyn_str(Dynamic_string *pdyn_str)
+{
+    free(pdyn_str->literals);
+    free(pdyn_str->ops);
+}
+
+int size_dyn_str(const Dynamic_string *pdyn_str, char **words_list,
+                 int words_list_len)
+{
+    const Dynamic_op *pop;
+    int size = 1;
+    int length;
     int i;
-    /* Count length of dynamic_str */
-    for (i = 0; i < dyn_str.count_strings; i++)
+
+    for (i = 0; i < pdyn_str->op_count; i++)
     {
-        dyn_str_len += strlen(dyn_str.strings[i]);
+        pop = &pdyn_str->ops[i];
+        if (pop->kind == OP_LITERAL)
+        {
+            size += pop->length;
+            continue;
+        }
+        length = pop->index < words_list_len ? strlen(words_list[pop->index])
+                                             : 0;
+        if (pop->kind == OP_NUMBER && length < NUMBER_LENGTH)
+            length = NUMBER_LENGTH;
+        size += length > pop->width ? length : pop->width;
     }
-    dyn_str.len = dyn_str_len;
-
-    return dyn_str;
+    return size;
 }
 
-void free_dyn_str(Dynamic_string *pdyn_str)
+/* Write a word right-aligned on a width, returns the number of characters
+ * written */
+static int fill_word(char *str, const char *word, int width)
 {
-    int i;
-    for (i = 0; i < pdyn_str->count_strings; i++)
-        free(pdyn_str->strings[i]);
-    return;
+    int length = strlen(word);
+    int padding = width > length ? width - length : 0;
+
+    memset(str, ' ', padding);
+    memcpy(str + padding, word, length);
+    return padding + length;
 }
 
-int strlen_dyn_str(const Dynamic_string *pdyn_str) { return pdyn_str->len; }
+static int fill_number(char *str, const Dynamic_op *pop, const char *word,
+                       int cap)
+{
+    char *end;
+    long value = strtol(word, &end, 10);
+
+    /* Not a number: the word as is */
+    if (end == word)
+        return fill_word(str, word, pop->width);
 
-int fill_dyn_str(char *str, Dynamic_string *pdyn_str, char **words_list,
-                 int words_list_len)
+    if (pop->percent && cap > 0)
+        value = value / cap * 100 + value % cap * 100 / cap;
+    return sprintf(str, pop->zero_padding ? "%0*ld" : "%*ld", pop->width,
+                   value);
+}
+
+int fill_dyn_str(char *str, const Dynamic_string *pdyn_str, char **words_list,
+                 int words_list_len, int cap)
 {
+    const Dynamic_op *pop;
+    int length = 0;
     int i;
-    int status = 0;
-    str[0] = '\0';
 
     /* Fill dynamic string */
-    for (i = 0; i < pdyn_str->count_strings - 1; i++)
+    for (i = 0; i < pdyn_str->op_count; i++)
     {
-        if (pdyn_str->indexes[i] >= words_list_len)
-            return 0;
-        strcat(str, pdyn_str->strings[i]);
-        strcat(str, words_list[pdyn_str->indexes[i]]);
-        status++;
+        pop = &pdyn_str->ops[i];
+        switch (pop->kind)
+        {
+        case OP_LITERAL:
+            memcpy(str + length, pdyn_str->literals + pop->start, pop->length);
+            length += pop->length;
+            break;
+        case OP_WORD:
+            if (pop->index >= words_list_len)
+                return -1;
+            length += fill_word(str + length, words_list[pop->index], 0);
+            break;
+        case OP_NUMBER:
+            if (pop->index >= words_list_len)
+                return -1;
+            length +=
+                fill_number(str + length, pop, words_list[pop->index], cap);
+            break;
+        }
     }
-    strcat(str, pdyn_str->strings[pdyn_str->count_strings - 1]);
-    return status;
+    str[length] = '\0';
+    return length;
 }
 
 char *parse_splitted(char *str)
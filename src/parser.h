@@ -20,39 +20,60 @@
 
 #include <stdbool.h>
 
-#define MAX_DYN_STR_SIZE 10
+/* Widths of placeholders are limited, so that strings have a known bound */
+#define MAX_DYN_STR_WIDTH 64
+
+typedef enum
+{
+    OP_LITERAL, /* Span of the literals */
+    OP_WORD,    /* {index}: word of the input as is */
+    OP_NUMBER   /* {index:width}, {index:0width}, {index:width%} */
+} Dynamic_op_kind;
 
 typedef struct
 {
-    int indexes[MAX_DYN_STR_SIZE];
-    char *strings[MAX_DYN_STR_SIZE];
-    int inserts;
-    int count_strings;
-    int len;
-} Dynamic_string;
+    Dynamic_op_kind kind;
+    int start; /* OP_LITERAL */
+    int length;
+    int index; /* OP_WORD and OP_NUMBER */
+    int width;
+    bool zero_padding;
+    bool percent; /* Of the maximum value */
+} Dynamic_op;
 
+/* Template compiled once into a list of operations, rendered on each update
+ * in linear time and without allocation */
 typedef struct
 {
-    char *strings[MAX_DYN_STR_SIZE];
-    int count;
-} Dynamic_list;
+    char *literals;
+    Dynamic_op *ops;
+    int op_count;
+    int inserts; /* Placeholders */
+    int words;   /* Of the input needed, one more than the highest index */
+} Dynamic_string;
 
-/* Generate dynamic string structure by usual string */
+/* Generate dynamic string structure by usual string. Placeholders are {n}
+ * for the word n of the input, or {n:w} for the number at the beginning of
+ * the word n right-aligned on at least w characters (padded with zeros with
+ * {n:0w}, scaled to a percentage of the maximum value with {n:w%}). {{ is a
+ * literal brace. */
 Dynamic_string generate_dyn_str(const char *str);
 
 /* free all allocated memory by generate_dyn_str function */
 void free_dyn_str(Dynamic_string *pdyn_str);
 
-/* Get len of provided dynamic string */
-int strlen_dyn_str(const Dynamic_string *pdyn_str);
-
-/* Fill str buffer with combined pdyn_str and words_list.
- * Every {num} will be changed with words_list[num] string.
- * words_list have to have enough elements to represent all numbers in the
- * dynamic string. */
-int fill_dyn_str(char *str, Dynamic_string *pdyn_str, char **words_list,
+/* Size of the buffer needed to fill a dynamic string with given words,
+ * including the terminating null character */
+int size_dyn_str(const Dynamic_string *pdyn_str, char **words_list,
                  int words_list_len);
 
+/* Fill str buffer (of size_dyn_str bytes at least) with combined pdyn_str
+ * and words_list, cap being the maximum value for percentages. Returns the
+ * length of the string, or -1 if words_list does not have enough elements to
+ * represent all numbers in the dynamic string. */
+int fill_dyn_str(char *str, const Dynamic_string *pdyn_str, char **words_list,
+                 int words_list_len, int cap);
+
 /* Split string to blocks that separates by "' chars.
  * if str is a pointer to string than the function returns pointer to the first
  * block in the string, if str is NULL pointer then the function returns
@@ -0,0 +1,111 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pixelfont.h"
+#include <stddef.h>
+
+#define GLYPH_WIDTH 3
+#define GLYPH_ADVANCE (GLYPH_WIDTH + 1)
+
+/* Rows of the glyphs from the top, the leftmost pixel being the high bit */
+typedef struct
+{
+    char character;
+    unsigned char rows[PIXEL_FONT_HEIGHT];
+} Pixel_glyph;
+
+static const Pixel_glyph glyphs[] = {
+    {'0', {07, 05, 05, 05, 07}}, {'1', {02, 06, 02, 02, 07}},
+    {'2', {07, 01, 07, 04, 07}}, {'3', {07, 01, 07, 01, 07}},
+    {'4', {05, 05, 07, 01, 01}}, {'5', {07, 04, 07, 01, 07}},
+    {'6', {07, 04, 07, 05, 07}}, {'7', {07, 01, 01, 01, 01}},
+    {'8', {07, 05, 07, 05, 07}}, {'9', {07, 05, 07, 01, 07}},
+    {'%', {05, 01, 02, 04, 05}}, {'-', {00, 00, 07, 00, 00}},
+    {'+', {00, 02, 07, 02, 00}}, {'.', {00, 00, 00, 00, 02}},
+    {':', {00, 02, 00, 02, 00}}, {'/', {01, 01, 02, 04, 04}}};
+
+static const Pixel_glyph *find_glyph(char character)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(glyphs) / sizeof(glyphs[0]); i++)
+    {
+        if (glyphs[i].character == character)
+            return &glyphs[i];
+    }
+    return NULL;
+}
+
+static int lit(unsigned char row, int column)
+{
+    return (row >> (GLYPH_WIDTH - 1 - column)) & 1;
+}
+
+/* Count the characters of a UTF-8 string, not its bytes */
+static int count_characters(const char *string)
+{
+    int count = 0;
+
+    for (; *string != '\0'; string++)
+    {
+        if (((unsigned char)*string & 0xc0) != 0x80)
+            count++;
+    }
+    return count;
+}
+
+int pixel_font_width(const char *string, int scale)
+{
+    int count = count_characters(string);
+
+    return count == 0 ? 0 : (count * GLYPH_ADVANCE - 1) * scale;
+}
+
+void pixel_font_draw(const char *string, int x, int y, int scale,
+                     void (*fill)(void *data, int x, int y, int w, int h),
+                     void *data)
+{
+    const Pixel_glyph *pglyph;
+    int row, height, column, run;
+
+    for (; *string != '\0'; string++)
+    {
+        if (((unsigned char)*string & 0xc0) == 0x80)
+            continue;
+        pglyph = find_glyph(*string);
+        for (row = 0; pglyph != NULL && row < PIXEL_FONT_HEIGHT;
+             row += height)
+        {
+            /* Identical rows are drawn together */
+            for (height = 1; row + height < PIXEL_FONT_HEIGHT &&
+                             pglyph->rows[row + height] == pglyph->rows[row];
+                 height++)
+                ;
+            for (column = 0; column < GLYPH_WIDTH; column += run + 1)
+            {
+                for (run = 0; column + run < GLYPH_WIDTH &&
+                              lit(pglyph->rows[row], column + run);
+                     run++)
+                    ;
+                if (run > 0)
+                    fill(data, x + column * scale, y + row * scale,
+                         run * scale, height * scale);
+            }
+        }
+        x += GLYPH_ADVANCE * scale;
+    }
+}
@@ -0,0 +1,36 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIXELFONT_H
+#define PIXELFONT_H
+
+/* Built-in font of digits and a few signs (% - + . : /) drawn as rectangles,
+ * for numeric texts that need no font to be loaded. Glyphs are 3x5 pixels
+ * scaled by an integer factor. Other characters are left blank. */
+
+#define PIXEL_FONT_HEIGHT 5
+
+/* Width of a string drawn at a given scale */
+int pixel_font_width(const char *string, int scale);
+
+/* Call fill for each rectangle of a string whose top left corner is at x, y.
+ * Rectangles of the same glyph do not overlap. */
+void pixel_font_draw(const char *string, int x, int y, int scale,
+                     void (*fill)(void *data, int x, int y, int w, int h),
+                     void *data);
+
+#endif /* __PIXELFONT_H__ */
@@ -0,0 +1,188 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _XOPEN_SOURCE 500
+#include "reader.h"
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool reader_init(Line_reader *preader, int fd)
+{
+    preader->fd = fd;
+    preader->writer_fd = -1;
+    preader->size = READER_BUFFER_SIZE;
+    preader->start = 0;
+    preader->scan = 0;
+    preader->end = 0;
+    preader->eof = false;
+
+    /* One more byte to terminate an unterminated last line */
+    preader->buffer = (char *)malloc(preader->size + 1);
+    if (preader->buffer == NULL)
+        return false;
+
+    return true;
+}
+
+bool reader_init_fifo(Line_reader *preader, const char *path)
+{
+    struct stat status;
+    int fd;
+
+    if (mkfifo(path, 0600) == -1 && errno != EEXIST)
+    {
+        perror(path);
+        return false;
+    }
+
+    /* Opening for reading first so that opening for writing does not fail */
+    fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd == -1)
+    {
+        perror(path);
+        return false;
+    }
+    if (fstat(fd, &status) == -1 || !S_ISFIFO(status.st_mode))
+    {
+        fprintf(stderr, "Error: %s is not a named pipe.\n", path);
+        close(fd);
+        return false;
+    }
+
+    if (!reader_init(preader, fd))
+    {
+        close(fd);
+        return false;
+    }
+    preader->writer_fd = open(path, O_WRONLY | O_NONBLOCK);
+    if (preader->writer_fd == -1)
+    {
+        perror(path);
+        reader_free(preader);
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(preader->writer_fd, F_SETFD, FD_CLOEXEC);
+
+    return true;
+}
+
+/* Move the lines not consumed yet to the beginning of the buffer */
+static void compact(Line_reader *preader)
+{
+    if (preader->start == 0)
+        return;
+
+    memmove(preader->buffer, preader->buffer + preader->start,
+            preader->end - preader->start);
+    preader->end -= preader->start;
+    preader->scan -= preader->start;
+    preader->start = 0;
+}
+
+Read_status reader_fill(Line_reader *preader)
+{
+    ssize_t count;
+    char *new_buffer;
+
+    if (preader->eof)
+        return READ_EOF;
+
+    compact(preader);
+
+    if (preader->end == preader->size)
+    {
+        /* Let the complete lines be consumed first, the rest will be read on
+         * the next wakeup */
+        if (memchr(preader->buffer, '\n', preader->end) != NULL)
+            return READ_AGAIN;
+
+        /* A single line fills the whole buffer */
+        new_buffer = (char *)realloc(preader->buffer, 2 * preader->size + 1);
+        if (new_buffer == NULL)
+            return READ_ERROR;
+        preader->buffer = new_buffer;
+        preader->size *= 2;
+        print_loge("DEBUG: reader buffer grown to %zu bytes\n",
+                   preader->size);
+    }
+
+    do
+        count = read(preader->fd, preader->buffer + preader->end,
+                     preader->size - preader->end);
+    while (count == -1 && errno == EINTR);
+
+    if (count > 0)
+    {
+        preader->end += count;
+        return READ_AGAIN;
+    }
+    if (count == 0)
+    {
+        preader->eof = true;
+        return READ_EOF;
+    }
+    /* The named pipe is opened in non-blocking mode */
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return READ_AGAIN;
+    return READ_ERROR;
+}
+
+char *reader_next_line(Line_reader *preader)
+{
+    char *line = preader->buffer + preader->start;
+    char *newline = memchr(preader->buffer + preader->scan, '\n',
+                           preader->end - preader->scan);
+
+    if (newline == NULL)
+    {
+        preader->scan = preader->end;
+
+        /* Unterminated last line */
+        if (preader->eof && preader->start < preader->end)
+        {
+            preader->buffer[preader->end] = '\0';
+            preader->start = preader->end;
+            return line;
+        }
+        return NULL;
+    }
+
+    *newline = '\0';
+    preader->start = newline - preader->buffer + 1;
+    preader->scan = preader->start;
+    return line;
+}
+
+void reader_free(Line_reader *preader)
+{
+    if (preader->writer_fd != -1)
+    {
+        close(preader->writer_fd);
+        close(preader->fd);
+    }
+    free(preader->buffer);
+    preader->buffer = NULL;
+}
@@ -0,0 +1,69 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define READER_BUFFER_SIZE 4096
+
+typedef enum
+{
+    READ_AGAIN, /* Wait for the file descriptor to be readable again */
+    READ_EOF,   /* The writing end has been closed */
+    READ_ERROR
+} Read_status;
+
+typedef struct
+{
+    int fd;
+    int writer_fd; /* Named pipes only */
+    char *buffer;
+    size_t size;
+    size_t start; /* Beginning of the first line not consumed yet */
+    size_t scan;  /* Position from which to look for the next newline */
+    size_t end;   /* End of the data read so far */
+    bool eof;
+} Line_reader;
+
+/* Prepare a reader on a file descriptor, whose flags are left as they are
+ * since it may be shared with other processes (e.g. the standard input).
+ * Returns false if the buffer cannot be allocated. */
+bool reader_init(Line_reader *preader, int fd);
+
+/* Prepare a reader on a named pipe, created if it does not exist. A writing
+ * end is kept open so that writers closing the pipe do not cause an end of
+ * file. Returns false on failure. */
+bool reader_init_fifo(Line_reader *preader, const char *path);
+
+/* Read the file descriptor once it is readable: a single read is made, which
+ * cannot block, and what remains is read on the next wakeup. The buffer only
+ * grows when a single line does not fit in it. */
+Read_status reader_fill(Line_reader *preader);
+
+/* Returns the next complete line without its newline, or NULL if there is
+ * none. After the end of file, a last unterminated line is returned as well.
+ * The line can be modified in place and remains valid until the next call to
+ * reader_fill. */
+char *reader_next_line(Line_reader *preader);
+
+/* Free the buffer (and close the named pipe) */
+void reader_free(Line_reader *preader);
+
+#endif /* __READER_H__ */
@@ -0,0 +1,172 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _XOPEN_SOURCE 500
+#include "server.h"
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool fill_address(struct sockaddr_un *paddress, const char *path)
+{
+    if (strlen(path) >= sizeof(paddress->sun_path))
+        return false;
+
+    memset(paddress, 0, sizeof(*paddress));
+    paddress->sun_family = AF_UNIX;
+    strcpy(paddress->sun_path, path);
+    return true;
+}
+
+/* Whether another instance is listening on the socket */
+static bool socket_in_use(const struct sockaddr_un *paddress)
+{
+    bool in_use;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1)
+        return false;
+    in_use =
+        connect(fd, (const struct sockaddr *)paddress, sizeof(*paddress)) == 0;
+    close(fd);
+    return in_use;
+}
+
+bool server_open(Server *pserver, const char *path)
+{
+    struct sockaddr_un address;
+    int i;
+
+    pserver->path = path;
+    pserver->client_count = 0;
+    for (i = 0; i < SERVER_MAX_CLIENTS; i++)
+        pserver->clients[i].connected = false;
+
+    if (!fill_address(&address, path))
+    {
+        fprintf(stderr, "Error: socket path %s is too long.\n", path);
+        return false;
+    }
+
+    if (socket_in_use(&address))
+    {
+        fprintf(stderr, "Error: socket %s is already in use.\n", path);
+        return false;
+    }
+    unlink(path);
+
+    pserver->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (pserver->fd == -1)
+    {
+        perror("socket()");
+        return false;
+    }
+    fcntl(pserver->fd, F_SETFL, O_NONBLOCK);
+    fcntl(pserver->fd, F_SETFD, FD_CLOEXEC);
+
+    if (bind(pserver->fd, (struct sockaddr *)&address, sizeof(address)) ==
+            -1 ||
+        listen(pserver->fd, SERVER_MAX_CLIENTS) == -1)
+    {
+        perror("bind()");
+        close(pserver->fd);
+        return false;
+    }
+
+    return true;
+}
+
+bool server_has_room(const Server *pserver)
+{
+    return pserver->client_count < SERVER_MAX_CLIENTS;
+}
+
+void server_accept(Server *pserver)
+{
+    int fd;
+    int i;
+
+    while (server_has_room(pserver))
+    {
+        fd = accept(pserver->fd, NULL, NULL);
+        if (fd == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept()");
+            return;
+        }
+
+        for (i = 0; pserver->clients[i].connected; i++)
+            ;
+        if (!reader_init(&pserver->clients[i].reader, fd))
+        {
+            fprintf(stderr, "Error: Cannot allocate the input buffer\n");
+            close(fd);
+            return;
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        pserver->clients[i].connected = true;
+        pserver->clients[i].closing = false;
+        pserver->client_count++;
+        print_loge("DEBUG: client %d connected\n", i);
+    }
+}
+
+static void disconnect(Server *pserver, Client *pclient)
+{
+    int fd = pclient->reader.fd;
+
+    reader_free(&pclient->reader);
+    close(fd);
+    pclient->connected = false;
+    pserver->client_count--;
+}
+
+void server_close_clients(Server *pserver)
+{
+    int i;
+
+    for (i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        if (pserver->clients[i].connected && pserver->clients[i].closing)
+        {
+            disconnect(pserver, &pserver->clients[i]);
+            print_loge("DEBUG: client %d disconnected\n", i);
+        }
+    }
+}
+
+void server_close(Server *pserver)
+{
+    int i;
+
+    for (i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        if (pserver->clients[i].connected)
+            disconnect(pserver, &pserver->clients[i]);
+    }
+    close(pserver->fd);
+    unlink(pserver->path);
+}
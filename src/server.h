@@ -0,0 +1,58 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "reader.h"
+#include <stdbool.h>
+
+#define SERVER_MAX_CLIENTS 32
+
+typedef struct
+{
+    bool connected;
+    bool closing;
+    Line_reader reader;
+} Client;
+
+/* UNIX domain stream socket whose clients send lines of input */
+typedef struct
+{
+    int fd;
+    const char *path;
+    Client clients[SERVER_MAX_CLIENTS];
+    int client_count;
+} Server;
+
+/* Listen on the socket at the given path. A stale socket file left by a
+ * previous instance is replaced. Returns false on failure. */
+bool server_open(Server *pserver, const char *path);
+
+/* Accept the pending connections while there is room for them */
+void server_accept(Server *pserver);
+
+/* Whether more clients can be accepted */
+bool server_has_room(const Server *pserver);
+
+/* Disconnect the clients marked as closing */
+void server_close_clients(Server *pserver);
+
+/* Disconnect every client, close and remove the socket */
+void server_close(Server *pserver);
+
+#endif /* __SERVER_H__ */
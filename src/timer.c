@@ -0,0 +1,134 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _XOPEN_SOURCE 500
+#include "timer.h"
+#include "log.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static bool is_before(struct timespec a, struct timespec b)
+{
+    return a.tv_sec < b.tv_sec ||
+           (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+/* Make sure the timerfd expires no later than the earliest deadline */
+static void arm_fd(Timer_queue *pqueue)
+{
+    struct itimerspec spec = {.it_interval = {0, 0}};
+    bool found = false;
+    int i;
+
+    for (i = 0; i < pqueue->count; i++)
+    {
+        if (pqueue->timers[i].armed &&
+            (!found || is_before(pqueue->timers[i].deadline, spec.it_value)))
+        {
+            spec.it_value = pqueue->timers[i].deadline;
+            found = true;
+        }
+    }
+
+    /* Nothing to wait for or the timerfd already expires early enough. A
+     * timerfd left armed after a cancellation expires once for nothing. */
+    if (!found ||
+        (pqueue->fd_armed && !is_before(spec.it_value, pqueue->fd_deadline)))
+        return;
+
+    timerfd_settime(pqueue->fd, TFD_TIMER_ABSTIME, &spec, NULL);
+    pqueue->fd_deadline = spec.it_value;
+    pqueue->fd_armed = true;
+}
+
+bool timers_init(Timer_queue *pqueue, int count)
+{
+    pqueue->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (pqueue->fd == -1)
+        return false;
+
+    pqueue->timers = (Timer *)calloc(count, sizeof(Timer));
+    if (pqueue->timers == NULL)
+    {
+        close(pqueue->fd);
+        return false;
+    }
+    pqueue->count = count;
+    pqueue->fd_armed = false;
+    return true;
+}
+
+void timer_set(Timer_queue *pqueue, int id, int delay_ms)
+{
+    Timer *ptimer = &pqueue->timers[id];
+
+    clock_gettime(CLOCK_MONOTONIC, &ptimer->deadline);
+    ptimer->deadline.tv_sec += delay_ms / 1000;
+    ptimer->deadline.tv_nsec += (delay_ms % 1000) * 1000000L;
+    if (ptimer->deadline.tv_nsec >= 1000000000L)
+    {
+        ptimer->deadline.tv_sec++;
+        ptimer->deadline.tv_nsec -= 1000000000L;
+    }
+    ptimer->armed = true;
+
+    arm_fd(pqueue);
+}
+
+void timer_cancel(Timer_queue *pqueue, int id)
+{
+    pqueue->timers[id].armed = false;
+}
+
+void timers_acknowledge(Timer_queue *pqueue)
+{
+    uint64_t expirations;
+
+    if (read(pqueue->fd, &expirations, sizeof(expirations)) > 0)
+        pqueue->fd_armed = false;
+}
+
+int timers_pop_expired(Timer_queue *pqueue)
+{
+    struct timespec now;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (i = 0; i < pqueue->count; i++)
+    {
+        if (pqueue->timers[i].armed &&
+            !is_before(now, pqueue->timers[i].deadline))
+        {
+            pqueue->timers[i].armed = false;
+            print_loge("DEBUG: timer %d expired\n", i);
+            return i;
+        }
+    }
+
+    /* Deadlines postponed in the meantime */
+    arm_fd(pqueue);
+    return -1;
+}
+
+void timers_free(Timer_queue *pqueue)
+{
+    close(pqueue->fd);
+    free(pqueue->timers);
+}
@@ -0,0 +1,60 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdbool.h>
+#include <time.h>
+
+typedef struct
+{
+    struct timespec deadline;
+    bool armed;
+} Timer;
+
+/* Independent timers sharing a single timerfd (monotonic clock) that is armed
+ * at the earliest deadline. Postponing a deadline does not touch the timerfd:
+ * it expires early and is simply armed again at the new deadline. */
+typedef struct
+{
+    int fd;
+    Timer *timers;
+    int count;
+    struct timespec fd_deadline;
+    bool fd_armed;
+} Timer_queue;
+
+/* Create count timers, all disarmed. Returns false on failure. */
+bool timers_init(Timer_queue *pqueue, int count);
+
+/* Arm (or re-arm) a timer to expire delay_ms milliseconds from now */
+void timer_set(Timer_queue *pqueue, int id, int delay_ms);
+
+/* Disarm a timer */
+void timer_cancel(Timer_queue *pqueue, int id);
+
+/* To be called when the file descriptor is readable */
+void timers_acknowledge(Timer_queue *pqueue);
+
+/* Returns the identifier of an expired timer, which is disarmed, or -1 when
+ * no more timer has expired */
+int timers_pop_expired(Timer_queue *pqueue);
+
+void timers_free(Timer_queue *pqueue);
+
+#endif /* __TIMER_H__ */
@@ -0,0 +1,85 @@
+/* xob - A lightweight overlay volume/anything bar for the X Window System.
+ * Copyright (C) 2021 Florent Ch.
+ *
+ * xob is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * xob is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xob.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* xob-send - Send a line of input to an xob instance listening on a socket.
+ * It is meant to be spawned by keybindings in place of a shell writing to a
+ * named pipe. */
+
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_un address;
+    char message[4096];
+    size_t length = 0;
+    size_t word_length;
+    int fd;
+    int i;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s socket value [words...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (strlen(argv[1]) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Error: socket path is too long.\n");
+        return EXIT_FAILURE;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, argv[1]);
+
+    /* Words separated by spaces and a newline: a single line of input */
+    for (i = 2; i < argc; i++)
+    {
+        word_length = strlen(argv[i]);
+        if (length + word_length + 1 > sizeof(message))
+        {
+            fprintf(stderr, "Error: message is too long.\n");
+            return EXIT_FAILURE;
+        }
+        memcpy(message + length, argv[i], word_length);
+        length += word_length;
+        message[length++] = (i == argc - 1) ? '\n' : ' ';
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 ||
+        connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+    {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (write(fd, message, length) != (ssize_t)length)
+    {
+        perror("write()");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    close(fd);
+    return EXIT_SUCCESS;
+}